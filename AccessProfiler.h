@@ -0,0 +1,559 @@
+#ifndef ACCESS_PROFILER_H
+#define ACCESS_PROFILER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// This module has the per-register access profiler for the memory mapped
+// device classes, it is only compiled into the register access macros when
+// the ACCESS_PROFILING compile option is given, e.g.
+//
+// g++ -I . -DACCESS_PROFILING driver.cc -o driver
+//
+// Every register read, write, and bitfield read-modify-write is counted per
+// device and register offset, and the latency of reads and of whole bitfield
+// read-modify-writes (the read and the write back, a read-modify-write counts
+// as one read and one write) is sampled with the CPU timestamp counter into
+// log2 scale histograms, i.e. bucket N holds accesses that took between 2^N
+// and 2^(N+1)-1 cycles.
+//
+// The bulk paths (readRegisters, the bitmap scans and acknowledges,
+// readBlock/writeBlock, and loadTable) count one access per register of the
+// range, but their latency is not sampled, and the write back of the bits
+// acknowledged by forEachSetBit, and the values written through a
+// TableLoader from getTableLoader, are not counted.
+//
+// The counters are kept per-thread so the access path never contends on a
+// shared cache line or lock, the per-thread tables are only aggregated when
+// a report or stats lookup is requested.  Devices are keyed by a process
+// unique id, not by their address, and the counters of a device are
+// allocated a page of registers at a time on the first access to a register
+// of the page, so a large device only costs memory for the registers that are
+// actually used.  Use the report to find the hot registers (candidates for
+// shadowing) and the slow reads (candidates for batching).  This is a
+// completly static class, like BitBanger.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class AccessProfiler
+{
+  private:
+
+    struct Counters;
+
+  public:
+
+    // number of log2 latency histogram buckets, the last bucket catches everything above it
+    enum { NUM_BUCKETS = 32 };
+
+    // type of access being profiled
+    enum Access
+    {
+      READ,
+      WRITE,
+      READ_MODIFY_WRITE
+    };
+
+    // aggregated statistics for a single register of a single device
+    struct RegisterStats
+    {
+      uint64_t deviceId;
+      const void *device;
+      string name;
+      unsigned offset;
+      uint64_t reads;
+      uint64_t writes;
+      uint64_t sampledReads;
+      uint64_t readCycles;
+      uint64_t maxReadCycles;
+      uint64_t histogram[NUM_BUCKETS];
+    };
+
+    // process unique id of a profiled device, each device class has one of these, a device
+    // constructed at the address of a destroyed one, or a copy of a device, gets a new id
+    class DeviceId
+    {
+      public:
+        DeviceId() : _id(next()) {};
+        DeviceId(const DeviceId &) : _id(next()) {};
+        DeviceId &operator=(const DeviceId &){return (*this);};
+        uint64_t get(void) const {return (_id);};
+      private:
+        static uint64_t next(void){static atomic<uint64_t> id(0); return (id.fetch_add(1, memory_order_relaxed) + 1);};
+        uint64_t _id;
+    };
+
+    // scoped profiler for a single register access, the access macros declare one of these
+    // before touching the register, the destructor runs after the register value has been
+    // read so the sampled latency covers the actual memory mapped access
+    class Scope
+    {
+      public:
+        Scope(const DeviceId &id_, const void *device_, const char *name_, unsigned size_, unsigned register_, Access access_);
+        ~Scope();
+      private:
+        Counters *_counters;
+        uint64_t _start;
+    };
+
+    // only sample the latency of every Nth read on each thread, must be a power of 2, the default
+    // is 1, i.e. every read is timed, counting of reads and writes is not affected by the period
+    static void setSamplePeriod(unsigned period_);
+
+    // clear all the counters, this is best done when there are no accesses in progress
+    static void reset(void);
+
+    // count one access to each register of a range by a bulk path, the latency is not sampled
+    static void countRange(const DeviceId &id_, const void *device_, const char *name_, unsigned size_, unsigned register_, unsigned count_, Access access_);
+
+    // get the aggregated stats for one register of a device, returns false if it was never accessed,
+    // if several devices have lived at the same address the stats of the latest one are returned
+    static bool getStats(const void *device_, unsigned register_, RegisterStats &stats_);
+
+    // get the aggregated stats for all the registers that have been accessed
+    static void getAllStats(vector<RegisterStats> &stats_);
+
+    // print the hot register and slow read rankings, limited to the top N entries of each
+    static void report(FILE *file_ = stdout, unsigned topN_ = 10);
+
+    // return an approximate latency percentile in cycles from a log2 histogram,
+    // the upper bound of the bucket containing the requested percentile is returned
+    static uint64_t getPercentile(const RegisterStats &stats_, double percentile_);
+
+    // read the timestamp counter, falls back to the monotonic clock in nsec on non-x86 systems
+    static uint64_t readTimestamp(void);
+
+  private:
+
+    // per-thread counters for a single register, only the owning thread ever writes these,
+    // they are atomic just so the aggregation can read them without tearing
+    struct Counters
+    {
+      atomic<uint64_t> reads;
+      atomic<uint64_t> writes;
+      atomic<uint64_t> sampledReads;
+      atomic<uint64_t> readCycles;
+      atomic<uint64_t> maxReadCycles;
+      atomic<uint64_t> histogram[NUM_BUCKETS];
+    };
+
+    // registers per page of counters
+    enum { PAGE_REGISTERS = 16 };
+
+    // per-thread counters for all the registers of a single device, the pages are only
+    // allocated by the owning thread, with the table lock held
+    struct DeviceCounters
+    {
+      uint64_t id;
+      const void *device;
+      string name;
+      unsigned size;
+      unique_ptr<unique_ptr<Counters[]>[]> pages;
+    };
+
+    // all the device counters for a single thread, the lock is only taken by the owning
+    // thread when it first sees a new device, and by the aggregation functions
+    struct ThreadTable
+    {
+      mutex lock;
+      vector<unique_ptr<DeviceCounters>> devices;
+      unordered_map<uint64_t, DeviceCounters *> lookup;
+      DeviceCounters *last;
+      unsigned sampleTick;
+    };
+
+    // global list of every thread table ever created, tables outlive their threads
+    // so the counters of exited threads still show up in the reports
+    struct Registry
+    {
+      mutex lock;
+      vector<unique_ptr<ThreadTable>> tables;
+      atomic<unsigned> samplePeriodMask;
+    };
+
+    friend class Scope;
+
+    static Registry &getRegistry(void);
+    static ThreadTable &getThreadTable(void);
+    static Counters *getCounters(uint64_t id_, const void *device_, const char *name_, unsigned size_, unsigned register_);
+    static bool shouldSample(void);
+    static unsigned getBucket(uint64_t cycles_);
+    static void increment(atomic<uint64_t> &counter_, uint64_t amount_ = 1){counter_.store(counter_.load(memory_order_relaxed) + amount_, memory_order_relaxed);};
+    static void printStats(FILE *file_, const RegisterStats &stats_);
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline AccessProfiler::Scope::Scope(const DeviceId &id_, const void *device_, const char *name_, unsigned size_, unsigned register_, Access access_)
+{
+  _start = 0;
+  _counters = getCounters(id_.get(), device_, name_, size_, register_);
+  if (_counters == NULL)
+  {
+    // out of range register, error checking (if enabled) will catch it
+    return;
+  }
+  if (access_ != READ)
+  {
+    increment(_counters->writes);
+  }
+  if (access_ != WRITE)
+  {
+    increment(_counters->reads);
+    if (shouldSample())
+    {
+      _start = readTimestamp();
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline AccessProfiler::Scope::~Scope()
+{
+  if (_start != 0)
+  {
+    uint64_t cycles = readTimestamp() - _start;
+    increment(_counters->sampledReads);
+    increment(_counters->readCycles, cycles);
+    increment(_counters->histogram[getBucket(cycles)]);
+    if (cycles > _counters->maxReadCycles.load(memory_order_relaxed))
+    {
+      _counters->maxReadCycles.store(cycles, memory_order_relaxed);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline uint64_t AccessProfiler::readTimestamp(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  // rdtscp waits for all previous instructions (i.e. the register read) to complete,
+  // the lfence keeps later instructions from starting before the timestamp is taken
+  unsigned aux;
+  uint64_t timestamp = __rdtscp(&aux);
+  _mm_lfence();
+  return (timestamp);
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec*1000000000ULL + now.tv_nsec);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline AccessProfiler::Registry &AccessProfiler::getRegistry(void)
+{
+  static Registry registry;
+  return (registry);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline AccessProfiler::ThreadTable &AccessProfiler::getThreadTable(void)
+{
+  static thread_local ThreadTable *table = NULL;
+  if (table == NULL)
+  {
+    Registry &registry = getRegistry();
+    lock_guard<mutex> guard(registry.lock);
+    registry.tables.emplace_back(new ThreadTable());
+    table = registry.tables.back().get();
+    table->last = NULL;
+    table->sampleTick = 0;
+  }
+  return (*table);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline AccessProfiler::Counters *AccessProfiler::getCounters(uint64_t id_, const void *device_, const char *name_, unsigned size_, unsigned register_)
+{
+  ThreadTable &table = getThreadTable();
+  DeviceCounters *device = table.last;
+  if ((device == NULL) || (device->id != id_))
+  {
+    unordered_map<uint64_t, DeviceCounters *>::iterator entry = table.lookup.find(id_);
+    if (entry != table.lookup.end())
+    {
+      device = entry->second;
+    }
+    else
+    {
+      // first access to this device from this thread, setup its counters
+      device = new DeviceCounters();
+      device->id = id_;
+      device->device = device_;
+      device->name = name_;
+      device->size = size_;
+      device->pages.reset(new unique_ptr<Counters[]>[(size_ + PAGE_REGISTERS - 1)/PAGE_REGISTERS]);
+      lock_guard<mutex> guard(table.lock);
+      table.devices.emplace_back(device);
+      table.lookup[id_] = device;
+    }
+    table.last = device;
+  }
+  if (register_ >= device->size)
+  {
+    return (NULL);
+  }
+  unique_ptr<Counters[]> &page = device->pages[register_/PAGE_REGISTERS];
+  if (page == NULL)
+  {
+    // first access to this page of registers from this thread
+    lock_guard<mutex> guard(table.lock);
+    page.reset(new Counters[PAGE_REGISTERS]());
+  }
+  return (&page[register_ % PAGE_REGISTERS]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void AccessProfiler::countRange(const DeviceId &id_, const void *device_, const char *name_, unsigned size_, unsigned register_, unsigned count_, Access access_)
+{
+  for (unsigned i = 0; i < count_; i++)
+  {
+    Counters *counters = getCounters(id_.get(), device_, name_, size_, register_ + i);
+    if (counters == NULL)
+    {
+      // out of range register, error checking (if enabled) will catch it
+      return;
+    }
+    if (access_ != READ)
+    {
+      increment(counters->writes);
+    }
+    if (access_ != WRITE)
+    {
+      increment(counters->reads);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline bool AccessProfiler::shouldSample(void)
+{
+  ThreadTable &table = getThreadTable();
+  return ((table.sampleTick++ & getRegistry().samplePeriodMask.load(memory_order_relaxed)) == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline unsigned AccessProfiler::getBucket(uint64_t cycles_)
+{
+  unsigned bucket = 63 - __builtin_clzll(cycles_ | 1);
+  return ((bucket < NUM_BUCKETS) ? bucket : (NUM_BUCKETS-1));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void AccessProfiler::setSamplePeriod(unsigned period_)
+{
+  if ((period_ == 0) || ((period_ & (period_-1)) != 0))
+  {
+    printf("ERROR: PROFILER: sample period: %d, must be a non-zero power of 2\n", period_);
+    return;
+  }
+  getRegistry().samplePeriodMask.store(period_-1, memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void AccessProfiler::reset(void)
+{
+  Registry &registry = getRegistry();
+  lock_guard<mutex> registryGuard(registry.lock);
+  for (unsigned i = 0; i < registry.tables.size(); i++)
+  {
+    ThreadTable &table = *registry.tables[i];
+    lock_guard<mutex> tableGuard(table.lock);
+    for (unsigned j = 0; j < table.devices.size(); j++)
+    {
+      DeviceCounters &device = *table.devices[j];
+      for (unsigned k = 0; k < device.size; k++)
+      {
+        if (device.pages[k/PAGE_REGISTERS] == NULL)
+        {
+          k += PAGE_REGISTERS - 1;
+          continue;
+        }
+        Counters &counters = device.pages[k/PAGE_REGISTERS][k % PAGE_REGISTERS];
+        counters.reads.store(0, memory_order_relaxed);
+        counters.writes.store(0, memory_order_relaxed);
+        counters.sampledReads.store(0, memory_order_relaxed);
+        counters.readCycles.store(0, memory_order_relaxed);
+        counters.maxReadCycles.store(0, memory_order_relaxed);
+        for (unsigned bucket = 0; bucket < NUM_BUCKETS; bucket++)
+        {
+          counters.histogram[bucket].store(0, memory_order_relaxed);
+        }
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void AccessProfiler::getAllStats(vector<RegisterStats> &stats_)
+{
+  // aggregate by device id and register offset across all the thread tables
+  map<pair<uint64_t, unsigned>, RegisterStats> aggregate;
+  Registry &registry = getRegistry();
+  lock_guard<mutex> registryGuard(registry.lock);
+  for (unsigned i = 0; i < registry.tables.size(); i++)
+  {
+    ThreadTable &table = *registry.tables[i];
+    lock_guard<mutex> tableGuard(table.lock);
+    for (unsigned j = 0; j < table.devices.size(); j++)
+    {
+      DeviceCounters &device = *table.devices[j];
+      for (unsigned k = 0; k < device.size; k++)
+      {
+        if (device.pages[k/PAGE_REGISTERS] == NULL)
+        {
+          k += PAGE_REGISTERS - 1;
+          continue;
+        }
+        Counters &counters = device.pages[k/PAGE_REGISTERS][k % PAGE_REGISTERS];
+        uint64_t reads = counters.reads.load(memory_order_relaxed);
+        uint64_t writes = counters.writes.load(memory_order_relaxed);
+        if ((reads == 0) && (writes == 0))
+        {
+          continue;
+        }
+        pair<uint64_t, unsigned> key(device.id, k);
+        map<pair<uint64_t, unsigned>, RegisterStats>::iterator entry = aggregate.find(key);
+        if (entry == aggregate.end())
+        {
+          RegisterStats stats = {};
+          stats.deviceId = device.id;
+          stats.device = device.device;
+          stats.name = device.name;
+          stats.offset = k;
+          entry = aggregate.insert(make_pair(key, stats)).first;
+        }
+        RegisterStats &stats = entry->second;
+        stats.reads += reads;
+        stats.writes += writes;
+        stats.sampledReads += counters.sampledReads.load(memory_order_relaxed);
+        stats.readCycles += counters.readCycles.load(memory_order_relaxed);
+        stats.maxReadCycles = max(stats.maxReadCycles, (uint64_t)counters.maxReadCycles.load(memory_order_relaxed));
+        for (unsigned bucket = 0; bucket < NUM_BUCKETS; bucket++)
+        {
+          stats.histogram[bucket] += counters.histogram[bucket].load(memory_order_relaxed);
+        }
+      }
+    }
+  }
+  stats_.clear();
+  for (map<pair<uint64_t, unsigned>, RegisterStats>::iterator entry = aggregate.begin(); entry != aggregate.end(); ++entry)
+  {
+    stats_.push_back(entry->second);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline bool AccessProfiler::getStats(const void *device_, unsigned register_, RegisterStats &stats_)
+{
+  // the stats are in device id order, so the last match is the latest device at that address
+  vector<RegisterStats> stats;
+  getAllStats(stats);
+  bool found = false;
+  for (unsigned i = 0; i < stats.size(); i++)
+  {
+    if ((stats[i].device == device_) && (stats[i].offset == register_))
+    {
+      stats_ = stats[i];
+      found = true;
+    }
+  }
+  return (found);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline uint64_t AccessProfiler::getPercentile(const RegisterStats &stats_, double percentile_)
+{
+  if (stats_.sampledReads == 0)
+  {
+    return (0);
+  }
+  uint64_t target = (uint64_t)(stats_.sampledReads*percentile_/100.0);
+  uint64_t count = 0;
+  for (unsigned bucket = 0; bucket < NUM_BUCKETS; bucket++)
+  {
+    count += stats_.histogram[bucket];
+    if ((count > target) || (count == stats_.sampledReads))
+    {
+      return ((2ULL << bucket) - 1);
+    }
+  }
+  return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void AccessProfiler::printStats(FILE *file_, const RegisterStats &stats_)
+{
+  uint64_t mean = (stats_.sampledReads > 0) ? (stats_.readCycles/stats_.sampledReads) : 0;
+  fprintf(file_, "  %-20s %6u %12llu %12llu %10llu %10llu %10llu %10llu\n",
+          stats_.name.c_str(),
+          stats_.offset,
+          (unsigned long long)stats_.reads,
+          (unsigned long long)stats_.writes,
+          (unsigned long long)mean,
+          (unsigned long long)getPercentile(stats_, 50.0),
+          (unsigned long long)getPercentile(stats_, 99.0),
+          (unsigned long long)stats_.maxReadCycles);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void AccessProfiler::report(FILE *file_, unsigned topN_)
+{
+  vector<RegisterStats> stats;
+  getAllStats(stats);
+
+  fprintf(file_, "\nHot registers, ranked by total accesses:\n\n");
+  fprintf(file_, "  %-20s %6s %12s %12s %10s %10s %10s %10s\n", "device", "reg", "reads", "writes", "mean", "p50", "p99", "max");
+  sort(stats.begin(), stats.end(), [](const RegisterStats &a_, const RegisterStats &b_){return ((a_.reads+a_.writes) > (b_.reads+b_.writes));});
+  for (unsigned i = 0; (i < stats.size()) && (i < topN_); i++)
+  {
+    printStats(file_, stats[i]);
+  }
+
+  fprintf(file_, "\nSlow reads, ranked by mean read latency (cycles):\n\n");
+  fprintf(file_, "  %-20s %6s %12s %12s %10s %10s %10s %10s\n", "device", "reg", "reads", "writes", "mean", "p50", "p99", "max");
+  stats.erase(remove_if(stats.begin(), stats.end(), [](const RegisterStats &stats_){return (stats_.sampledReads == 0);}), stats.end());
+  // the means compared exactly by cross multiplying, in 128 bits as the cycle totals can use most of 64
+  sort(stats.begin(), stats.end(), [](const RegisterStats &a_, const RegisterStats &b_){return (((unsigned __int128)a_.readCycles*b_.sampledReads) > ((unsigned __int128)b_.readCycles*a_.sampledReads));});
+  for (unsigned i = 0; (i < stats.size()) && (i < topN_); i++)
+  {
+    printStats(file_, stats[i]);
+  }
+  fprintf(file_, "\n");
+}
+
+#endif
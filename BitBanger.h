@@ -2,6 +2,7 @@
 #define BIT_BANGER_H
 
 #include <BitfieldMacros.h>
+#include <BulkBitfield.h>
 
 ////////////////////////////////////////////////////////////////////////////////
 //
@@ -9,7 +10,9 @@
 // passed in values, there is no memory mapping/access of hardware devices,
 // it assumes the values are accessed by other means.  This is a completly
 // static class with the accessor functions overloaded based on the data
-// width of the values passed into the functions.
+// width of the values passed into the functions.  The array versions get/
+// set/test a bitfield across a whole buffer of 16 or 32-bit values using the
+// SIMD kernels in BulkBitfield.h.
 //
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -29,5 +32,20 @@ class BitBanger
     static void setBitfield(uint32_t &fullValue_, unsigned lowOrderBit_, unsigned highOrderBit_, uint32_t bitfieldValue_){SET_VALUE_BITFIELD32(fullValue_, lowOrderBit_, highOrderBit_, bitfieldValue_);};
     static uint32_t getBitfield(uint32_t fullValue_, unsigned lowOrderBit_, unsigned highOrderBit_){GET_VALUE_BITFIELD32(fullValue_, lowOrderBit_, highOrderBit_);};
 
+    // get/set bitfield for arrays of 16-bit values, one bitfield value per full value
+    static void setBitfields(uint16_t *fullValues_, size_t count_, unsigned lowOrderBit_, unsigned highOrderBit_, const uint16_t *bitfieldValues_){BulkBitfield::insert(fullValues_, count_, lowOrderBit_, highOrderBit_, bitfieldValues_);};
+    static void getBitfields(const uint16_t *fullValues_, size_t count_, unsigned lowOrderBit_, unsigned highOrderBit_, uint16_t *bitfieldValues_){BulkBitfield::extract(fullValues_, count_, lowOrderBit_, highOrderBit_, bitfieldValues_);};
+
+    // get/set bitfield for arrays of 32-bit values, one bitfield value per full value
+    static void setBitfields(uint32_t *fullValues_, size_t count_, unsigned lowOrderBit_, unsigned highOrderBit_, const uint32_t *bitfieldValues_){BulkBitfield::insert(fullValues_, count_, lowOrderBit_, highOrderBit_, bitfieldValues_);};
+    static void getBitfields(const uint32_t *fullValues_, size_t count_, unsigned lowOrderBit_, unsigned highOrderBit_, uint32_t *bitfieldValues_){BulkBitfield::extract(fullValues_, count_, lowOrderBit_, highOrderBit_, bitfieldValues_);};
+
+    // test bitfield for arrays of 16/32-bit values, count the values whose bitfield equals the
+    // bitfield value, or find the index of the first one (count if there is none)
+    static size_t countBitfieldMatches(const uint16_t *fullValues_, size_t count_, unsigned lowOrderBit_, unsigned highOrderBit_, uint16_t bitfieldValue_){return (BulkBitfield::countMatches(fullValues_, count_, lowOrderBit_, highOrderBit_, bitfieldValue_));};
+    static size_t countBitfieldMatches(const uint32_t *fullValues_, size_t count_, unsigned lowOrderBit_, unsigned highOrderBit_, uint32_t bitfieldValue_){return (BulkBitfield::countMatches(fullValues_, count_, lowOrderBit_, highOrderBit_, bitfieldValue_));};
+    static size_t findBitfieldMatch(const uint16_t *fullValues_, size_t count_, unsigned lowOrderBit_, unsigned highOrderBit_, uint16_t bitfieldValue_){return (BulkBitfield::findFirstMatch(fullValues_, count_, lowOrderBit_, highOrderBit_, bitfieldValue_));};
+    static size_t findBitfieldMatch(const uint32_t *fullValues_, size_t count_, unsigned lowOrderBit_, unsigned highOrderBit_, uint32_t bitfieldValue_){return (BulkBitfield::findFirstMatch(fullValues_, count_, lowOrderBit_, highOrderBit_, bitfieldValue_));};
+
 };
 #endif
@@ -3,6 +3,9 @@
 
 #include <stdio.h>
 #include <arpa/inet.h>
+#include <endian.h>
+
+#include <DeviceLog.h>
 
 ////////////////////////////////////////////////////////////////////////////////
 //
@@ -21,6 +24,8 @@
 #define NTOHS(n) (n)
 #define HTONL(n) (n)
 #define NTOHL(n) (n)
+#define HTONLL(n) (n)
+#define NTOHLL(n) (n)
 
 // simple endianess checker, were forcing big endian at compile time, hardcode to return true
 inline bool isBigEndian(void)
@@ -46,6 +51,9 @@ inline bool isBigEndian(void)
                   ((((uint32_t)(n) & 0xFF0000)) >> 8) | \
                   ((((uint32_t)(n) & 0xFF000000)) >> 24))
 
+#define HTONLL(n) __builtin_bswap64((uint64_t)(n))
+#define NTOHLL(n) __builtin_bswap64((uint64_t)(n))
+
 // simple endianess checker, were forcing little endian at compile time, hardcode to return false
 inline bool isBigEndian(void)
 {
@@ -62,6 +70,9 @@ inline bool isBigEndian(void)
 #define HTONL(n) htonl(n)
 #define NTOHL(n) ntohl(n)
 
+#define HTONLL(n) htobe64(n)
+#define NTOHLL(n) be64toh(n)
+
 // simple endianess checker, we auto detect the endianess
 inline bool isBigEndian(void)
 {
@@ -74,7 +85,8 @@ inline bool isBigEndian(void)
 // all these macros are designed to only work with the MemoryMappedHardware classes,
 // they were just put in a separate file rather than that file for readability purposes
 
-#define MAX_BITFIELD_VALUE(lowOrderBit, highOrderBit) (unsigned)((1<<(highOrderBit-lowOrderBit+1))-1)
+// the max value is computed in 64 bits, so a full width (e.g. 0-31) bitfield does not shift out of range
+#define MAX_BITFIELD_VALUE(lowOrderBit, highOrderBit) (unsigned)((1ULL<<(highOrderBit-lowOrderBit+1))-1)
 #define BITMASK(lowOrderBit, highOrderBit) (MAX_BITFIELD_VALUE(lowOrderBit, highOrderBit)<<lowOrderBit)
 #define SET_BITFIELD8(fullValue, lowOrderBit, highOrderBit, bitfieldValue) (fullValue = ((fullValue & ~BITMASK(lowOrderBit, highOrderBit)) | (bitfieldValue << lowOrderBit)))
 #define GET_BITFIELD8(fullValue, lowOrderBit, highOrderBit) return(((fullValue & BITMASK(lowOrderBit, highOrderBit)) >> lowOrderBit));
@@ -83,6 +95,19 @@ inline bool isBigEndian(void)
 #define SET_BITFIELD32(fullValue, lowOrderBit, highOrderBit, bitfieldValue) (fullValue = NTOHL(((HTONL(fullValue) & ~BITMASK(lowOrderBit, highOrderBit)) | (bitfieldValue << lowOrderBit))))
 #define GET_BITFIELD32(fullValue, lowOrderBit, highOrderBit) return(((HTONL(fullValue) & BITMASK(lowOrderBit, highOrderBit)) >> lowOrderBit));
 
+// lazy mapping, a device constructed with a device path is mmapped on its first access,
+// see DeviceDescriptor.h, this is a single well predicted branch once mapped, the acquire
+// load pairs with the release store in map, which serializes concurrent first accesses,
+// after a failed map (which is not retried) it is a lock free check of the failed flag
+#define ENSURE_MAPPED() \
+  if (__builtin_expect(__atomic_load_n(&_address, __ATOMIC_ACQUIRE) == NULL, 0)) \
+  { \
+    if (!__atomic_load_n(&_mapFailed, __ATOMIC_ACQUIRE)) \
+    { \
+      map(); \
+    } \
+  }
+
 // undefine this for performance
 #if defined(ERROR_CHECKING)
 
@@ -140,6 +165,20 @@ inline bool isBigEndian(void)
     return (0); \
   }
 
+// range of registers, the optional last argument is the error return value
+#define REGISTER_RANGE_ERROR_CHECKING(register_, count_, ...) \
+  ENSURE_MAPPED() \
+  if (_address == NULL) \
+  { \
+    DeviceLog::log(DeviceLog::ERROR, "device: %s, REGISTER: address is NULL", getName()); \
+    return __VA_ARGS__; \
+  } \
+  else if ((register_ + count_) > _size) \
+  { \
+    DeviceLog::log(DeviceLog::ERROR, "device: %s, REGISTER: requested registers: %d-%d, exceed memory mapped size: %d", getName(), register_, (register_ + count_ - 1), _size); \
+    return __VA_ARGS__; \
+  }
+
 #else
 
 // dummy macros when compiling for performance
@@ -147,47 +186,105 @@ inline bool isBigEndian(void)
 #define GET_REGISTER_ERROR_CHECKING(register_)
 #define SET_BITFIELD_ERROR_CHECKING(lowOrderBit_, highOrderBit_, numBits_, value_)
 #define GET_BITFIELD_ERROR_CHECKING(lowOrderBit_, highOrderBit_, numBits_)
+#define REGISTER_RANGE_ERROR_CHECKING(register_, count_, ...)
 
 #endif
 
+// compile with ACCESS_PROFILING to count and time register accesses, see AccessProfiler.h
+#if defined(ACCESS_PROFILING)
+
+#include <AccessProfiler.h>
+
+#define PROFILE_REGISTER_ACCESS(register_, access_) \
+  AccessProfiler::Scope _accessProfilerScope(_profilerId, this, getName(), _size, register_, AccessProfiler::access_);
+
+// the bulk paths count one access per register of the range, without timing it
+#define PROFILE_REGISTER_RANGE_ACCESS(register_, count_, access_) \
+  AccessProfiler::countRange(_profilerId, this, getName(), _size, register_, count_, AccessProfiler::access_);
+
+// the profiler id member of the device classes
+#define PROFILER_DEVICE_ID \
+  AccessProfiler::DeviceId _profilerId;
+
+#else
+
+// dummy macros when not profiling
+#define PROFILE_REGISTER_ACCESS(register_, access_)
+#define PROFILE_REGISTER_RANGE_ACCESS(register_, count_, access_)
+#define PROFILER_DEVICE_ID
+
+#endif
+
+// byte lane sub-word bitfield write for devices with byte enables, see SubwordAccess.h,
+// writes byte and aligned halfword bitfields with a single narrow store and returns
+#define SET_SUBWORD_BITFIELD(register_, lowOrderBit_, highOrderBit_, value_) \
+  if (_subwordAccess) \
+  { \
+    int laneOffset = SubwordAccess::getLaneOffset<decltype(value_)>(lowOrderBit_, highOrderBit_); \
+    if (laneOffset >= 0) \
+    { \
+      PROFILE_REGISTER_ACCESS(register_, WRITE) \
+      SubwordAccess::write(&_address[register_], laneOffset, lowOrderBit_, highOrderBit_, value_); \
+      return; \
+    } \
+  }
+
 // thes macros are used by the MemoryMappedHardware classes and
 // assume a base memory mapped address of a given HW device
 #define SET_REGISTER_BITFIELD8(register_, lowOrderBit_, highOrderBit_, value_) \
+  ENSURE_MAPPED() \
   SET_REGISTER_ERROR_CHECKING(register_) \
   SET_BITFIELD_ERROR_CHECKING(lowOrderBit_, highOrderBit_, 8, value_) \
+  PROFILE_REGISTER_ACCESS(register_, READ_MODIFY_WRITE) \
   SET_BITFIELD8(_address[register_], lowOrderBit_, highOrderBit_, value_)
 
 #define GET_REGISTER_BITFIELD8(register_, lowOrderBit_, highOrderBit_) \
+  ENSURE_MAPPED() \
   GET_REGISTER_ERROR_CHECKING(register_) \
   GET_BITFIELD_ERROR_CHECKING(lowOrderBit_, highOrderBit_, 8) \
+  PROFILE_REGISTER_ACCESS(register_, READ) \
   GET_BITFIELD8(_address[register_], lowOrderBit_, highOrderBit_)
 
 #define SET_REGISTER_BITFIELD16(register_, lowOrderBit_, highOrderBit_, value_) \
+  ENSURE_MAPPED() \
   SET_REGISTER_ERROR_CHECKING(register_) \
   SET_BITFIELD_ERROR_CHECKING(lowOrderBit_, highOrderBit_, 16, value_) \
+  SET_SUBWORD_BITFIELD(register_, lowOrderBit_, highOrderBit_, value_) \
+  PROFILE_REGISTER_ACCESS(register_, READ_MODIFY_WRITE) \
   SET_BITFIELD16(_address[register_], lowOrderBit_, highOrderBit_, value_)
 
 #define GET_REGISTER_BITFIELD16(register_, lowOrderBit_, highOrderBit_) \
+  ENSURE_MAPPED() \
   GET_REGISTER_ERROR_CHECKING(register_) \
   GET_BITFIELD_ERROR_CHECKING(lowOrderBit_, highOrderBit_, 16) \
+  PROFILE_REGISTER_ACCESS(register_, READ) \
   GET_BITFIELD16(_address[register_], lowOrderBit_, highOrderBit_)
 
 #define SET_REGISTER_BITFIELD32(register_, lowOrderBit_, highOrderBit_, value_) \
+  ENSURE_MAPPED() \
   SET_REGISTER_ERROR_CHECKING(register_) \
   SET_BITFIELD_ERROR_CHECKING(lowOrderBit_, highOrderBit_, 32, value_) \
+  SET_SUBWORD_BITFIELD(register_, lowOrderBit_, highOrderBit_, value_) \
+  PROFILE_REGISTER_ACCESS(register_, READ_MODIFY_WRITE) \
   SET_BITFIELD32(_address[register_], lowOrderBit_, highOrderBit_, value_)
 
 #define GET_REGISTER_BITFIELD32(register_, lowOrderBit_, highOrderBit_) \
+  ENSURE_MAPPED() \
   GET_REGISTER_ERROR_CHECKING(register_) \
   GET_BITFIELD_ERROR_CHECKING(lowOrderBit_, highOrderBit_, 32) \
+  PROFILE_REGISTER_ACCESS(register_, READ) \
   GET_BITFIELD32(_address[register_], lowOrderBit_, highOrderBit_)
 
 #define SET_REGISTER_VALUE(register_, value_) \
+  ENSURE_MAPPED() \
   SET_REGISTER_ERROR_CHECKING(register_) \
+  PROFILE_REGISTER_ACCESS(register_, WRITE) \
   _address[register_] = value_;
 
 #define GET_REGISTER_VALUE(register_) \
+  ENSURE_MAPPED() \
   GET_REGISTER_ERROR_CHECKING(register_) \
+  PROFILE_REGISTER_ACCESS(register_, READ) \
   return(_address[register_]);
 
 // thes macros are used by the BitBanger classes and use the passed in values as-is,
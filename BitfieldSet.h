@@ -0,0 +1,295 @@
+#ifndef BITFIELD_SET_H
+#define BITFIELD_SET_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <initializer_list>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include <BitmapScan.h>
+#include <CpuFeatures.h>
+#include <DeviceLog.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// This module has the multi-field extract/insert API for decoding/encoding
+// several bitfields of one 8, 16, or 32-bit value in one go, i.e. the multi
+// field version of BitBanger::getBitfield/setBitfield, with the same endian
+// adjusted bit numbering.  A BitfieldSet is built once from the bitfield
+// specifications, e.g.
+//
+// BitfieldSet<uint32_t> status({{MY_32BIT_REG0_BITFIELD1}, {MY_32BIT_REG0_BITFIELD2}, {MY_32BIT_REG0_BITFIELD3}});
+// uint32_t fields[3];
+// status.extract(value, fields);
+//
+// extract/insert byte swap the value once for all the fields (rather than
+// once per field as repeated getBitfield calls do) and then mask and shift
+// each field.  extractPacked/insertPacked gather/scatter all the fields to/
+// from one value with the fields packed together in ascending bit order, they
+// use the BMI2 PEXT/PDEP instructions when the CPU has them, and a portable
+// per-field loop otherwise, the choice is made at runtime once.  Note that
+// PEXT/PDEP are microcoded and slow on AMD CPUs before Zen 3, use
+// setImplementation(PORTABLE) on those.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// a single bitfield specification, same as the <lowOrderBit>,<highOrderBit> bitfield macros
+struct Bitfield
+{
+  unsigned lowOrderBit;
+  unsigned highOrderBit;
+};
+
+template <typename T>
+class BitfieldSet
+{
+  static_assert(sizeof(T) <= 4, "BitfieldSet supports up to 32-bit values, the BMI2 pext/pdep paths are 32-bit");
+
+  public:
+
+    enum { MAX_BITFIELDS = sizeof(T)*8 };
+
+    enum Implementation
+    {
+      AUTO,       // BMI2 if the CPU has it, otherwise portable
+      PORTABLE,
+      BMI2
+    };
+
+    BitfieldSet(const Bitfield *bitfields_, unsigned count_){setup(bitfields_, count_);};
+    BitfieldSet(initializer_list<Bitfield> bitfields_){setup(bitfields_.begin(), bitfields_.size());};
+
+    // return if all the bitfields were valid and non-overlapping, no fields are accessed if not
+    bool isValid(void) const {return (_valid);};
+
+    // return the number of bitfields, and the endian adjusted mask of all of them
+    unsigned getCount(void) const {return (_count);};
+    T getMask(void) const {return (_mask);};
+
+    // return the bit offset of a bitfield in the packed value
+    unsigned getPackedOffset(unsigned bitfield_) const {return (_packedOffset[bitfield_]);};
+
+    // get/set all the bitfields, one value per bitfield in the order they were given
+    void extract(T fullValue_, T *bitfieldValues_) const;
+    void insert(T &fullValue_, const T *bitfieldValues_) const;
+
+    // get/set all the bitfields packed together in ascending bit order (PEXT/PDEP)
+    T extractPacked(T fullValue_) const;
+    void insertPacked(T &fullValue_, T packed_) const;
+
+    // array versions, count full values in, count*getCount() bitfield values (row per
+    // full value) or count packed values out
+    void extract(const T *fullValues_, T *bitfieldValues_, size_t count_) const;
+    void extractPacked(const T *fullValues_, T *packed_, size_t count_) const;
+
+    // override the implementation selection, e.g. for benchmarking, BMI2 is only honored if the CPU has it
+    static void setImplementation(Implementation implementation_){getBmi2() = (implementation_ != PORTABLE) && CpuFeatures::hasBmi2();};
+    static bool isUsingBmi2(void){return (getBmi2());};
+
+  private:
+
+    void setup(const Bitfield *bitfields_, unsigned count_);
+
+    // portable gather/scatter of the fields, on the endian adjusted value
+    T gather(T value_) const;
+    T scatter(T packed_) const;
+
+    static bool &getBmi2(void){static bool bmi2 = CpuFeatures::hasBmi2(); return (bmi2);};
+
+    bool _valid;
+    unsigned _count;
+    T _mask;
+    uint8_t _lowOrderBit[MAX_BITFIELDS];
+    uint8_t _packedOffset[MAX_BITFIELDS];
+    T _bitfieldMask[MAX_BITFIELDS];   // unshifted, i.e. max bitfield value
+
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// the BMI2 versions, these are compiled for BMI2 regardless of the compile options,
+// they are only ever called after the runtime check says the CPU has BMI2
+namespace BitfieldSetBmi2
+{
+  __attribute__((target("bmi2"))) inline uint32_t pext(uint32_t value_, uint32_t mask_){return (_pext_u32(value_, mask_));}
+  __attribute__((target("bmi2"))) inline uint32_t pdep(uint32_t value_, uint32_t mask_){return (_pdep_u32(value_, mask_));}
+
+  template <typename T>
+  __attribute__((target("bmi2"))) inline void pextArray(const T *fullValues_, T *packed_, size_t count_, uint32_t mask_)
+  {
+    for (size_t i = 0; i < count_; i++)
+    {
+      packed_[i] = (T)_pext_u32(BitmapScan::toLogical(fullValues_[i]), mask_);
+    }
+  }
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void BitfieldSet<T>::setup(const Bitfield *bitfields_, unsigned count_)
+{
+  _valid = false;
+  _count = 0;
+  _mask = 0;
+  if (count_ > MAX_BITFIELDS)
+  {
+    DeviceLog::log(DeviceLog::ERROR, "BITFIELD SET: number of bitfields: %d, exceeds max: %d", count_, MAX_BITFIELDS);
+    return;
+  }
+
+  uint64_t mask = 0;
+  for (unsigned i = 0; i < count_; i++)
+  {
+    unsigned lowOrderBit = bitfields_[i].lowOrderBit;
+    unsigned highOrderBit = bitfields_[i].highOrderBit;
+    if ((lowOrderBit > highOrderBit) || (highOrderBit >= sizeof(T)*8))
+    {
+      DeviceLog::log(DeviceLog::ERROR, "BITFIELD SET: invalid bitfield: %d-%d, for %d-bit value", lowOrderBit, highOrderBit, (unsigned)sizeof(T)*8);
+      return;
+    }
+    uint64_t bitfieldMask = ((1ULL << (highOrderBit - lowOrderBit + 1)) - 1);
+    if ((mask & (bitfieldMask << lowOrderBit)) != 0)
+    {
+      DeviceLog::log(DeviceLog::ERROR, "BITFIELD SET: bitfield: %d-%d, overlaps another bitfield", lowOrderBit, highOrderBit);
+      return;
+    }
+    mask |= bitfieldMask << lowOrderBit;
+    _lowOrderBit[i] = lowOrderBit;
+    _bitfieldMask[i] = (T)bitfieldMask;
+  }
+
+  // the packed offset of a bitfield is the number of mask bits below it
+  for (unsigned i = 0; i < count_; i++)
+  {
+    _packedOffset[i] = __builtin_popcountll(mask & ((1ULL << _lowOrderBit[i]) - 1));
+  }
+  _mask = (T)mask;
+  _count = count_;
+  _valid = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline T BitfieldSet<T>::gather(T value_) const
+{
+  T packed = 0;
+  for (unsigned i = 0; i < _count; i++)
+  {
+    packed |= (T)(((value_ >> _lowOrderBit[i]) & _bitfieldMask[i]) << _packedOffset[i]);
+  }
+  return (packed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline T BitfieldSet<T>::scatter(T packed_) const
+{
+  T value = 0;
+  for (unsigned i = 0; i < _count; i++)
+  {
+    value |= (T)(((packed_ >> _packedOffset[i]) & _bitfieldMask[i]) << _lowOrderBit[i]);
+  }
+  return (value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void BitfieldSet<T>::extract(T fullValue_, T *bitfieldValues_) const
+{
+  T value = BitmapScan::toLogical(fullValue_);
+  for (unsigned i = 0; i < _count; i++)
+  {
+    bitfieldValues_[i] = (T)((value >> _lowOrderBit[i]) & _bitfieldMask[i]);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void BitfieldSet<T>::insert(T &fullValue_, const T *bitfieldValues_) const
+{
+  T value = (T)(BitmapScan::toLogical(fullValue_) & ~_mask);
+  for (unsigned i = 0; i < _count; i++)
+  {
+    value |= (T)((bitfieldValues_[i] & _bitfieldMask[i]) << _lowOrderBit[i]);
+  }
+  fullValue_ = BitmapScan::toRaw(value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline T BitfieldSet<T>::extractPacked(T fullValue_) const
+{
+  T value = BitmapScan::toLogical(fullValue_);
+#if defined(__x86_64__) || defined(__i386__)
+  if (getBmi2())
+  {
+    return ((T)BitfieldSetBmi2::pext(value, _mask));
+  }
+#endif
+  return (gather(value));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void BitfieldSet<T>::insertPacked(T &fullValue_, T packed_) const
+{
+  T bits;
+#if defined(__x86_64__) || defined(__i386__)
+  if (getBmi2())
+  {
+    bits = (T)BitfieldSetBmi2::pdep(packed_, _mask);
+  }
+  else
+#endif
+  {
+    bits = scatter(packed_);
+  }
+  fullValue_ = BitmapScan::toRaw((T)((BitmapScan::toLogical(fullValue_) & ~_mask) | bits));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void BitfieldSet<T>::extract(const T *fullValues_, T *bitfieldValues_, size_t count_) const
+{
+  for (size_t i = 0; i < count_; i++)
+  {
+    extract(fullValues_[i], &bitfieldValues_[i*_count]);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void BitfieldSet<T>::extractPacked(const T *fullValues_, T *packed_, size_t count_) const
+{
+#if defined(__x86_64__) || defined(__i386__)
+  if (getBmi2())
+  {
+    // dispatch once for the whole array so PEXT is inlined into the loop
+    BitfieldSetBmi2::pextArray(fullValues_, packed_, count_, _mask);
+    return;
+  }
+#endif
+  for (size_t i = 0; i < count_; i++)
+  {
+    packed_[i] = gather(BitmapScan::toLogical(fullValues_[i]));
+  }
+}
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef BITMAP_SCAN_H
+#define BITMAP_SCAN_H
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include <BitfieldMacros.h>
+#include <CpuFeatures.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// This module has the bitmap scanning primitives for wide banks of interrupt
+// cause/status registers, i.e. a run of consecutive 8, 16, or 32 bit registers
+// treated as one wide bitmap.  Bit N of the bitmap is bit (N % width) of the
+// register at (N / width) from the start of the bank, with the bit numbering
+// in each register the same as for the bitfield accessors, i.e. endian
+// adjusted.  These are used by the bitmap APIs of the MemoryMappedDevice
+// classes, they are not generally called directly.
+//
+// The bank is read a chunk of registers at a time into a local snapshot, each
+// register is read exactly once, and the snapshot is scanned for non-zero
+// registers 16 (SSE2) or 32 (AVX2) bytes at a time, so the cost of the bit
+// iteration grows with the number of set bits, not with the size of the bank.
+// The 32 byte version is used when the CPU has AVX2 (checked once at runtime,
+// see CpuFeatures.h), regardless of the compile options.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class BitmapScan
+{
+  public:
+
+    // number of registers snapshotted at a time
+    enum { CHUNK_SIZE = 64 };
+
+    // convert between the raw register value and the endian adjusted bit order
+    static uint8_t toLogical(uint8_t value_){return (value_);};
+    static uint16_t toLogical(uint16_t value_){return (HTONS(value_));};
+    static uint32_t toLogical(uint32_t value_){return (HTONL(value_));};
+    static uint64_t toLogical(uint64_t value_){return (HTONLL(value_));};
+    static uint8_t toRaw(uint8_t value_){return (value_);};
+    static uint16_t toRaw(uint16_t value_){return (NTOHS(value_));};
+    static uint32_t toRaw(uint32_t value_){return (NTOHL(value_));};
+    static uint64_t toRaw(uint64_t value_){return (NTOHLL(value_));};
+
+    // read count registers into values, raw, one read per register
+    template <typename T>
+    static void read(const volatile T *address_, unsigned count_, T *values_);
+
+    // return the index of the first non-zero value at or after start, or count if there is none
+    template <typename T>
+    static unsigned nextNonZero(const T *values_, unsigned start_, unsigned count_);
+
+    // return the number of set bits in the bank
+    template <typename T>
+    static unsigned countSetBits(const volatile T *address_, unsigned count_);
+
+    // return the bitmap index of the first set bit in the bank, or -1 if there is none,
+    // the bank is only read up to the first chunk with a set bit in it
+    template <typename T>
+    static int findFirstSetBit(const volatile T *address_, unsigned count_);
+
+    // call bool callback(unsigned bit) for every set bit in the bank in ascending order, if
+    // acknowledge is set every bit for which the callback returns true is written back as a
+    // 1 to its (write-1-to-clear) register, bits not handled are not written, registers with
+    // no handled bits are not written at all, returns the number of set bits found
+    template <typename T, class Callback>
+    static unsigned forEachSetBit(volatile T *address_, unsigned count_, Callback callback_, bool acknowledge_);
+
+    // write-1-to-clear acknowledge, writes the bits (endian adjusted) to each register
+    // of the bank that has any bits to acknowledge, no reads are done
+    template <typename T>
+    static void acknowledgeBits(volatile T *address_, unsigned count_, const T *bits_);
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void BitmapScan::read(const volatile T *address_, unsigned count_, T *values_)
+{
+  for (unsigned i = 0; i < count_; i++)
+  {
+    values_[i] = address_[i];
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+namespace BitmapScanSimd
+{
+  // scan 32 bytes at a time from offset for the first non-zero byte, sets found and returns
+  // its offset, or returns the offset of the remaining bytes that are less than 32
+  __attribute__((target("avx2"))) inline unsigned nextNonZeroAvx2(const uint8_t *bytes_, unsigned offset_, unsigned length_, bool &found_)
+  {
+    const __m256i zero = _mm256_setzero_si256();
+    for (; (offset_ + 32) <= length_; offset_ += 32)
+    {
+      unsigned mask = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)&bytes_[offset_]), zero));
+      if (mask != 0)
+      {
+        found_ = true;
+        return (offset_ + __builtin_ctz(mask));
+      }
+    }
+    found_ = false;
+    return (offset_);
+  }
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline unsigned BitmapScan::nextNonZero(const T *values_, unsigned start_, unsigned count_)
+{
+  const uint8_t *bytes = (const uint8_t *)values_;
+  unsigned offset = start_*sizeof(T);
+  unsigned length = count_*sizeof(T);
+#if defined(__x86_64__) || defined(__i386__)
+  if (CpuFeatures::hasAvx2())
+  {
+    bool found;
+    offset = BitmapScanSimd::nextNonZeroAvx2(bytes, offset, length, found);
+    if (found)
+    {
+      return (offset/sizeof(T));
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i zero128 = _mm_setzero_si128();
+  for (; (offset + 16) <= length; offset += 16)
+  {
+    unsigned mask = ~(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&bytes[offset]), zero128)) & 0xffff;
+    if (mask != 0)
+    {
+      return ((offset + __builtin_ctz(mask))/sizeof(T));
+    }
+  }
+#endif
+  for (unsigned i = offset/sizeof(T); i < count_; i++)
+  {
+    if (values_[i] != 0)
+    {
+      return (i);
+    }
+  }
+  return (count_);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline unsigned BitmapScan::countSetBits(const volatile T *address_, unsigned count_)
+{
+  unsigned bits = 0;
+  for (unsigned i = 0; i < count_; i++)
+  {
+    // byte swapping does not change the number of set bits
+    bits += __builtin_popcount(address_[i]);
+  }
+  return (bits);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline int BitmapScan::findFirstSetBit(const volatile T *address_, unsigned count_)
+{
+  T values[CHUNK_SIZE];
+  for (unsigned base = 0; base < count_; base += CHUNK_SIZE)
+  {
+    unsigned chunk = ((count_ - base) < (unsigned)CHUNK_SIZE) ? (count_ - base) : (unsigned)CHUNK_SIZE;
+    read(&address_[base], chunk, values);
+    unsigned i = nextNonZero(values, 0, chunk);
+    if (i < chunk)
+    {
+      return ((base + i)*sizeof(T)*8 + __builtin_ctz(toLogical(values[i])));
+    }
+  }
+  return (-1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T, class Callback>
+inline unsigned BitmapScan::forEachSetBit(volatile T *address_, unsigned count_, Callback callback_, bool acknowledge_)
+{
+  T values[CHUNK_SIZE];
+  unsigned found = 0;
+  for (unsigned base = 0; base < count_; base += CHUNK_SIZE)
+  {
+    unsigned chunk = ((count_ - base) < (unsigned)CHUNK_SIZE) ? (count_ - base) : (unsigned)CHUNK_SIZE;
+    read(&address_[base], chunk, values);
+    for (unsigned i = nextNonZero(values, 0, chunk); i < chunk; i = nextNonZero(values, i+1, chunk))
+    {
+      unsigned bits = toLogical(values[i]);
+      unsigned handled = 0;
+      found += __builtin_popcount(bits);
+      while (bits != 0)
+      {
+        unsigned bit = __builtin_ctz(bits);
+        bits &= bits - 1;
+        if (callback_((base + i)*sizeof(T)*8 + bit))
+        {
+          handled |= 1u << bit;
+        }
+      }
+      if (acknowledge_ && (handled != 0))
+      {
+        address_[base + i] = toRaw((T)handled);
+      }
+    }
+  }
+  return (found);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void BitmapScan::acknowledgeBits(volatile T *address_, unsigned count_, const T *bits_)
+{
+  for (unsigned i = 0; i < count_; i++)
+  {
+    if (bits_[i] != 0)
+    {
+      address_[i] = toRaw(bits_[i]);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,619 @@
+#ifndef BULK_BITFIELD_H
+#define BULK_BITFIELD_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include <BitmapScan.h>
+#include <CpuFeatures.h>
+#include <DeviceLog.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// This module has the array versions of the 16 and 32-bit BitBanger bitfield
+// accessors, i.e. get/set/test the same bitfield across a whole buffer of
+// captured register values, with the same endian adjusted bit numbering as
+// getBitfield/setBitfield.  These are used by the array overloads of the
+// BitBanger functions, they are not generally called directly.
+//
+// The byte swap is fused with the mask and shift, 16 (SSSE3) or 32 (AVX2)
+// bytes of values at a time, using a byte shuffle (PSHUFB) for the swap, with
+// a scalar loop for the tail and for CPUs without SSSE3.  The instruction set
+// is picked at runtime once (see CpuFeatures.h), so no special compile options
+// are needed.  The scalar loops take the swap as a template parameter, so
+// there is no per value byte order conversion call in them.  The test functions do not swap at all, the field value and mask
+// are converted to the raw byte order once and compared against the raw values.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class BulkBitfield
+{
+  public:
+
+    enum Implementation
+    {
+      AUTO,       // the widest the CPU has
+      SCALAR,
+      SSSE3,
+      AVX2
+    };
+
+    // get the bitfield of count values into bitfieldValues
+    template <typename T>
+    static void extract(const T *fullValues_, size_t count_, unsigned lowOrderBit_, unsigned highOrderBit_, T *bitfieldValues_);
+
+    // set the bitfield of count values from bitfieldValues, the bitfield values are truncated to the bitfield width
+    template <typename T>
+    static void insert(T *fullValues_, size_t count_, unsigned lowOrderBit_, unsigned highOrderBit_, const T *bitfieldValues_);
+
+    // return the number of values whose bitfield equals bitfieldValue
+    template <typename T>
+    static size_t countMatches(const T *fullValues_, size_t count_, unsigned lowOrderBit_, unsigned highOrderBit_, T bitfieldValue_);
+
+    // return the index of the first value whose bitfield equals bitfieldValue, or count if there is none
+    template <typename T>
+    static size_t findFirstMatch(const T *fullValues_, size_t count_, unsigned lowOrderBit_, unsigned highOrderBit_, T bitfieldValue_);
+
+    // override the implementation selection, e.g. for benchmarking, an
+    // implementation the CPU does not have falls back to the next narrower one
+    static void setImplementation(Implementation implementation_){getImplementation() = select(implementation_);};
+    static Implementation getSelectedImplementation(void){return (getImplementation());};
+
+  private:
+
+    static Implementation select(Implementation implementation_);
+    static Implementation &getImplementation(void){static Implementation implementation = select(AUTO); return (implementation);};
+
+    template <typename T>
+    static bool isValid(unsigned lowOrderBit_, unsigned highOrderBit_);
+
+    // also check that the value fits in the bitfield
+    template <typename T>
+    static bool isValid(unsigned lowOrderBit_, unsigned highOrderBit_, T bitfieldValue_);
+
+    // the unshifted mask of a bitfield, i.e. its max value
+    template <typename T>
+    static T getMask(unsigned lowOrderBit_, unsigned highOrderBit_){return ((T)((1ULL << (highOrderBit_ - lowOrderBit_ + 1)) - 1));};
+
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// the SIMD kernels, these are compiled for SSSE3/AVX2 regardless of the
+// compile options, they are only ever called after the runtime check says the
+// CPU has the instruction set, each returns the number of values it did, the
+// caller does the remaining tail with the scalar code
+//
+////////////////////////////////////////////////////////////////////////////////
+
+namespace BulkBitfieldSimd
+{
+  // max number of vectors counted per lane before the lane counts are summed
+  const size_t COUNT_BLOCK = 0x7fff;
+
+  // byte shuffle control for swapping each 16, 32, or 64-bit lane of a 128-bit vector
+  template <typename T>
+  __attribute__((target("ssse3"))) inline __m128i getSwap128(void)
+  {
+    if (sizeof(T) == 2)
+    {
+      return (_mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
+    }
+    if (sizeof(T) == 8)
+    {
+      return (_mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8));
+    }
+    return (_mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+  }
+
+  template <typename T>
+  __attribute__((target("ssse3"))) inline __m128i set1(T value_)
+  {
+    return ((sizeof(T) == 2) ? _mm_set1_epi16((short)value_) : _mm_set1_epi32((int)value_));
+  }
+
+  template <typename T>
+  __attribute__((target("ssse3"))) inline __m128i cmpeq(__m128i a_, __m128i b_)
+  {
+    return ((sizeof(T) == 2) ? _mm_cmpeq_epi16(a_, b_) : _mm_cmpeq_epi32(a_, b_));
+  }
+
+  template <typename T, bool Swap>
+  __attribute__((target("ssse3"))) inline size_t extractSsse3(const T *fullValues_, size_t count_, unsigned lowOrderBit_, T mask_, T *bitfieldValues_)
+  {
+    const size_t lanes = 16/sizeof(T);
+    const __m128i swap = getSwap128<T>();
+    const __m128i mask = set1<T>(mask_);
+    const __m128i shift = _mm_cvtsi32_si128(lowOrderBit_);
+    size_t i = 0;
+    for (; (i + lanes) <= count_; i += lanes)
+    {
+      __m128i values = _mm_loadu_si128((const __m128i *)&fullValues_[i]);
+      if (Swap)
+      {
+        values = _mm_shuffle_epi8(values, swap);
+      }
+      values = (sizeof(T) == 2) ? _mm_srl_epi16(values, shift) : _mm_srl_epi32(values, shift);
+      _mm_storeu_si128((__m128i *)&bitfieldValues_[i], _mm_and_si128(values, mask));
+    }
+    return (i);
+  }
+
+  template <typename T, bool Swap>
+  __attribute__((target("ssse3"))) inline size_t insertSsse3(T *fullValues_, size_t count_, unsigned lowOrderBit_, T mask_, const T *bitfieldValues_)
+  {
+    const size_t lanes = 16/sizeof(T);
+    const __m128i swap = getSwap128<T>();
+    const __m128i mask = set1<T>(mask_);
+    const __m128i shift = _mm_cvtsi32_si128(lowOrderBit_);
+    const __m128i shiftedMask = (sizeof(T) == 2) ? _mm_sll_epi16(mask, shift) : _mm_sll_epi32(mask, shift);
+    size_t i = 0;
+    for (; (i + lanes) <= count_; i += lanes)
+    {
+      __m128i values = _mm_loadu_si128((const __m128i *)&fullValues_[i]);
+      __m128i bits = _mm_and_si128(_mm_loadu_si128((const __m128i *)&bitfieldValues_[i]), mask);
+      bits = (sizeof(T) == 2) ? _mm_sll_epi16(bits, shift) : _mm_sll_epi32(bits, shift);
+      if (Swap)
+      {
+        values = _mm_shuffle_epi8(values, swap);
+      }
+      values = _mm_or_si128(_mm_andnot_si128(shiftedMask, values), bits);
+      if (Swap)
+      {
+        values = _mm_shuffle_epi8(values, swap);
+      }
+      _mm_storeu_si128((__m128i *)&fullValues_[i], values);
+    }
+    return (i);
+  }
+
+  // the raw mask/value are already in the raw byte order, returns the matches found in matches
+  template <typename T>
+  __attribute__((target("ssse3"))) inline size_t countSsse3(const T *fullValues_, size_t count_, T rawMask_, T rawValue_, size_t &matches_)
+  {
+    const size_t lanes = 16/sizeof(T);
+    const __m128i mask = set1<T>(rawMask_);
+    const __m128i value = set1<T>(rawValue_);
+    size_t i = 0;
+    while ((i + lanes) <= count_)
+    {
+      // each lane of the compare is 0 or -1, subtract them into per lane counts, and sum
+      // the lanes every COUNT_BLOCK vectors so the 16-bit lane counts cannot overflow
+      __m128i counts = _mm_setzero_si128();
+      for (size_t block = 0; (block < COUNT_BLOCK) && ((i + lanes) <= count_); block++, i += lanes)
+      {
+        __m128i values = _mm_and_si128(_mm_loadu_si128((const __m128i *)&fullValues_[i]), mask);
+        counts = (sizeof(T) == 2) ? _mm_sub_epi16(counts, cmpeq<T>(values, value)) : _mm_sub_epi32(counts, cmpeq<T>(values, value));
+      }
+      T laneCounts[lanes];
+      _mm_storeu_si128((__m128i *)laneCounts, counts);
+      for (size_t lane = 0; lane < lanes; lane++)
+      {
+        matches_ += laneCounts[lane];
+      }
+    }
+    return (i);
+  }
+
+  // returns the index of the first vector with a match, and its lane in lane, or the number of values done
+  template <typename T>
+  __attribute__((target("ssse3"))) inline size_t findSsse3(const T *fullValues_, size_t count_, T rawMask_, T rawValue_, int &lane_)
+  {
+    const size_t lanes = 16/sizeof(T);
+    const __m128i mask = set1<T>(rawMask_);
+    const __m128i value = set1<T>(rawValue_);
+    size_t i = 0;
+    for (; (i + lanes) <= count_; i += lanes)
+    {
+      __m128i values = _mm_and_si128(_mm_loadu_si128((const __m128i *)&fullValues_[i]), mask);
+      unsigned matches = _mm_movemask_epi8(cmpeq<T>(values, value));
+      if (matches != 0)
+      {
+        lane_ = __builtin_ctz(matches)/sizeof(T);
+        return (i);
+      }
+    }
+    return (i);
+  }
+
+  // the AVX2 versions of the above, PSHUFB only shuffles within each 128-bit half,
+  // which is all a lane swap needs
+  template <typename T>
+  __attribute__((target("avx2"))) inline __m256i getSwap256(void)
+  {
+    if (sizeof(T) == 2)
+    {
+      return (_mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                               1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
+    }
+    if (sizeof(T) == 8)
+    {
+      return (_mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                               7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8));
+    }
+    return (_mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                             3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+  }
+
+  template <typename T>
+  __attribute__((target("avx2"))) inline __m256i set1x2(T value_)
+  {
+    return ((sizeof(T) == 2) ? _mm256_set1_epi16((short)value_) : _mm256_set1_epi32((int)value_));
+  }
+
+  template <typename T>
+  __attribute__((target("avx2"))) inline __m256i cmpeqx2(__m256i a_, __m256i b_)
+  {
+    return ((sizeof(T) == 2) ? _mm256_cmpeq_epi16(a_, b_) : _mm256_cmpeq_epi32(a_, b_));
+  }
+
+  template <typename T, bool Swap>
+  __attribute__((target("avx2"))) inline size_t extractAvx2(const T *fullValues_, size_t count_, unsigned lowOrderBit_, T mask_, T *bitfieldValues_)
+  {
+    const size_t lanes = 32/sizeof(T);
+    const __m256i swap = getSwap256<T>();
+    const __m256i mask = set1x2<T>(mask_);
+    const __m128i shift = _mm_cvtsi32_si128(lowOrderBit_);
+    size_t i = 0;
+    for (; (i + lanes) <= count_; i += lanes)
+    {
+      __m256i values = _mm256_loadu_si256((const __m256i *)&fullValues_[i]);
+      if (Swap)
+      {
+        values = _mm256_shuffle_epi8(values, swap);
+      }
+      values = (sizeof(T) == 2) ? _mm256_srl_epi16(values, shift) : _mm256_srl_epi32(values, shift);
+      _mm256_storeu_si256((__m256i *)&bitfieldValues_[i], _mm256_and_si256(values, mask));
+    }
+    return (i);
+  }
+
+  template <typename T, bool Swap>
+  __attribute__((target("avx2"))) inline size_t insertAvx2(T *fullValues_, size_t count_, unsigned lowOrderBit_, T mask_, const T *bitfieldValues_)
+  {
+    const size_t lanes = 32/sizeof(T);
+    const __m256i swap = getSwap256<T>();
+    const __m256i mask = set1x2<T>(mask_);
+    const __m128i shift = _mm_cvtsi32_si128(lowOrderBit_);
+    const __m256i shiftedMask = (sizeof(T) == 2) ? _mm256_sll_epi16(mask, shift) : _mm256_sll_epi32(mask, shift);
+    size_t i = 0;
+    for (; (i + lanes) <= count_; i += lanes)
+    {
+      __m256i values = _mm256_loadu_si256((const __m256i *)&fullValues_[i]);
+      __m256i bits = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)&bitfieldValues_[i]), mask);
+      bits = (sizeof(T) == 2) ? _mm256_sll_epi16(bits, shift) : _mm256_sll_epi32(bits, shift);
+      if (Swap)
+      {
+        values = _mm256_shuffle_epi8(values, swap);
+      }
+      values = _mm256_or_si256(_mm256_andnot_si256(shiftedMask, values), bits);
+      if (Swap)
+      {
+        values = _mm256_shuffle_epi8(values, swap);
+      }
+      _mm256_storeu_si256((__m256i *)&fullValues_[i], values);
+    }
+    return (i);
+  }
+
+  template <typename T>
+  __attribute__((target("avx2"))) inline size_t countAvx2(const T *fullValues_, size_t count_, T rawMask_, T rawValue_, size_t &matches_)
+  {
+    const size_t lanes = 32/sizeof(T);
+    const __m256i mask = set1x2<T>(rawMask_);
+    const __m256i value = set1x2<T>(rawValue_);
+    size_t i = 0;
+    while ((i + lanes) <= count_)
+    {
+      __m256i counts = _mm256_setzero_si256();
+      for (size_t block = 0; (block < COUNT_BLOCK) && ((i + lanes) <= count_); block++, i += lanes)
+      {
+        __m256i values = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)&fullValues_[i]), mask);
+        counts = (sizeof(T) == 2) ? _mm256_sub_epi16(counts, cmpeqx2<T>(values, value)) : _mm256_sub_epi32(counts, cmpeqx2<T>(values, value));
+      }
+      T laneCounts[lanes];
+      _mm256_storeu_si256((__m256i *)laneCounts, counts);
+      for (size_t lane = 0; lane < lanes; lane++)
+      {
+        matches_ += laneCounts[lane];
+      }
+    }
+    return (i);
+  }
+
+  template <typename T>
+  __attribute__((target("avx2"))) inline size_t findAvx2(const T *fullValues_, size_t count_, T rawMask_, T rawValue_, int &lane_)
+  {
+    const size_t lanes = 32/sizeof(T);
+    const __m256i mask = set1x2<T>(rawMask_);
+    const __m256i value = set1x2<T>(rawValue_);
+    size_t i = 0;
+    for (; (i + lanes) <= count_; i += lanes)
+    {
+      __m256i values = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)&fullValues_[i]), mask);
+      unsigned matches = _mm256_movemask_epi8(cmpeqx2<T>(values, value));
+      if (matches != 0)
+      {
+        lane_ = __builtin_ctz(matches)/sizeof(T);
+        return (i);
+      }
+    }
+    return (i);
+  }
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// the scalar loops, for the tail of the SIMD kernels, and all of it without
+// them, the swap is a template parameter, i.e. decided once outside the loop
+//
+////////////////////////////////////////////////////////////////////////////////
+
+namespace BulkBitfieldScalar
+{
+  // values per block of the 16-bit loops
+  const size_t BLOCK_SIZE = 16;
+
+  inline uint16_t swapBytes(uint16_t value_){return (__builtin_bswap16(value_));}
+  inline uint32_t swapBytes(uint32_t value_){return (__builtin_bswap32(value_));}
+
+  template <bool Swap, typename T>
+  inline T swapIf(T value_){return (Swap ? swapBytes(value_) : value_);}
+
+  // the 16-bit values are done a block at a time into a local buffer, which has a
+  // known trip count and can not alias the inputs, so g++ vectorizes it even at
+  // -O2 (a 16-bit swap is just shifts), the 32-bit swap needs a byte shuffle,
+  // i.e. the SIMD kernels, so the 32-bit values are done one at a time
+  template <typename T, bool Swap>
+  inline void extract(const T *fullValues_, size_t start_, size_t count_, unsigned lowOrderBit_, T mask_, T *bitfieldValues_)
+  {
+    size_t i = start_;
+    if (sizeof(T) == 2)
+    {
+      for (; (i + BLOCK_SIZE) <= count_; i += BLOCK_SIZE)
+      {
+        T values[BLOCK_SIZE];
+        for (size_t j = 0; j < BLOCK_SIZE; j++)
+        {
+          values[j] = (T)((swapIf<Swap>(fullValues_[i + j]) >> lowOrderBit_) & mask_);
+        }
+        memcpy(&bitfieldValues_[i], values, sizeof(values));
+      }
+    }
+    for (; i < count_; i++)
+    {
+      bitfieldValues_[i] = (T)((swapIf<Swap>(fullValues_[i]) >> lowOrderBit_) & mask_);
+    }
+  }
+
+  template <typename T, bool Swap>
+  inline void insert(T *fullValues_, size_t start_, size_t count_, unsigned lowOrderBit_, T mask_, const T *bitfieldValues_)
+  {
+    T shiftedMask = (T)(mask_ << lowOrderBit_);
+    size_t i = start_;
+    if (sizeof(T) == 2)
+    {
+      for (; (i + BLOCK_SIZE) <= count_; i += BLOCK_SIZE)
+      {
+        T values[BLOCK_SIZE];
+        for (size_t j = 0; j < BLOCK_SIZE; j++)
+        {
+          T value = (T)((swapIf<Swap>(fullValues_[i + j]) & ~shiftedMask) | ((bitfieldValues_[i + j] & mask_) << lowOrderBit_));
+          values[j] = swapIf<Swap>(value);
+        }
+        memcpy(&fullValues_[i], values, sizeof(values));
+      }
+    }
+    for (; i < count_; i++)
+    {
+      T value = (T)((swapIf<Swap>(fullValues_[i]) & ~shiftedMask) | ((bitfieldValues_[i] & mask_) << lowOrderBit_));
+      fullValues_[i] = swapIf<Swap>(value);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline BulkBitfield::Implementation BulkBitfield::select(Implementation implementation_)
+{
+  if (((implementation_ == AUTO) || (implementation_ == AVX2)) && CpuFeatures::hasAvx2())
+  {
+    return (AVX2);
+  }
+  if ((implementation_ != SCALAR) && CpuFeatures::hasSsse3())
+  {
+    return (SSSE3);
+  }
+  return (SCALAR);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline bool BulkBitfield::isValid(unsigned lowOrderBit_, unsigned highOrderBit_)
+{
+  if (lowOrderBit_ > highOrderBit_)
+  {
+    DeviceLog::log(DeviceLog::ERROR, "BITFIELD: lowOrderBit: %d, is greater than highOrderBit: %d", lowOrderBit_, highOrderBit_);
+    return (false);
+  }
+  else if (highOrderBit_ > (sizeof(T)*8-1))
+  {
+    DeviceLog::log(DeviceLog::ERROR, "BITFIELD: highOrderBit: %d, exceeds range: 0-%d, for %d-bit value", highOrderBit_, (unsigned)(sizeof(T)*8-1), (unsigned)sizeof(T)*8);
+    return (false);
+  }
+  return (true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline bool BulkBitfield::isValid(unsigned lowOrderBit_, unsigned highOrderBit_, T bitfieldValue_)
+{
+  if (!isValid<T>(lowOrderBit_, highOrderBit_))
+  {
+    return (false);
+  }
+  if (bitfieldValue_ > getMask<T>(lowOrderBit_, highOrderBit_))
+  {
+    DeviceLog::log(DeviceLog::ERROR, "BITFIELD: value: %u, exceeds max bitfield value: %u", (unsigned)bitfieldValue_, (unsigned)getMask<T>(lowOrderBit_, highOrderBit_));
+    return (false);
+  }
+  return (true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void BulkBitfield::extract(const T *fullValues_, size_t count_, unsigned lowOrderBit_, unsigned highOrderBit_, T *bitfieldValues_)
+{
+#if defined(ERROR_CHECKING)
+  if (!isValid<T>(lowOrderBit_, highOrderBit_))
+  {
+    return;
+  }
+#endif
+  T mask = getMask<T>(lowOrderBit_, highOrderBit_);
+  size_t i = 0;
+  // the swap is a compile time constant, i.e. the untaken versions are optimized out
+  bool swap = (BitmapScan::toLogical((T)1) != 1);
+#if defined(__x86_64__) || defined(__i386__)
+  if (getImplementation() == AVX2)
+  {
+    i = swap ? BulkBitfieldSimd::extractAvx2<T, true>(fullValues_, count_, lowOrderBit_, mask, bitfieldValues_) :
+               BulkBitfieldSimd::extractAvx2<T, false>(fullValues_, count_, lowOrderBit_, mask, bitfieldValues_);
+  }
+  else if (getImplementation() == SSSE3)
+  {
+    i = swap ? BulkBitfieldSimd::extractSsse3<T, true>(fullValues_, count_, lowOrderBit_, mask, bitfieldValues_) :
+               BulkBitfieldSimd::extractSsse3<T, false>(fullValues_, count_, lowOrderBit_, mask, bitfieldValues_);
+  }
+#endif
+  if (swap)
+  {
+    BulkBitfieldScalar::extract<T, true>(fullValues_, i, count_, lowOrderBit_, mask, bitfieldValues_);
+  }
+  else
+  {
+    BulkBitfieldScalar::extract<T, false>(fullValues_, i, count_, lowOrderBit_, mask, bitfieldValues_);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void BulkBitfield::insert(T *fullValues_, size_t count_, unsigned lowOrderBit_, unsigned highOrderBit_, const T *bitfieldValues_)
+{
+#if defined(ERROR_CHECKING)
+  if (!isValid<T>(lowOrderBit_, highOrderBit_))
+  {
+    return;
+  }
+#endif
+  T mask = getMask<T>(lowOrderBit_, highOrderBit_);
+  size_t i = 0;
+  bool swap = (BitmapScan::toLogical((T)1) != 1);
+#if defined(__x86_64__) || defined(__i386__)
+  if (getImplementation() == AVX2)
+  {
+    i = swap ? BulkBitfieldSimd::insertAvx2<T, true>(fullValues_, count_, lowOrderBit_, mask, bitfieldValues_) :
+               BulkBitfieldSimd::insertAvx2<T, false>(fullValues_, count_, lowOrderBit_, mask, bitfieldValues_);
+  }
+  else if (getImplementation() == SSSE3)
+  {
+    i = swap ? BulkBitfieldSimd::insertSsse3<T, true>(fullValues_, count_, lowOrderBit_, mask, bitfieldValues_) :
+               BulkBitfieldSimd::insertSsse3<T, false>(fullValues_, count_, lowOrderBit_, mask, bitfieldValues_);
+  }
+#endif
+  if (swap)
+  {
+    BulkBitfieldScalar::insert<T, true>(fullValues_, i, count_, lowOrderBit_, mask, bitfieldValues_);
+  }
+  else
+  {
+    BulkBitfieldScalar::insert<T, false>(fullValues_, i, count_, lowOrderBit_, mask, bitfieldValues_);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline size_t BulkBitfield::countMatches(const T *fullValues_, size_t count_, unsigned lowOrderBit_, unsigned highOrderBit_, T bitfieldValue_)
+{
+#if defined(ERROR_CHECKING)
+  if (!isValid<T>(lowOrderBit_, highOrderBit_, bitfieldValue_))
+  {
+    return (0);
+  }
+#endif
+  T rawMask = BitmapScan::toRaw((T)(getMask<T>(lowOrderBit_, highOrderBit_) << lowOrderBit_));
+  T rawValue = BitmapScan::toRaw((T)(bitfieldValue_ << lowOrderBit_)) & rawMask;
+  size_t matches = 0;
+  size_t i = 0;
+#if defined(__x86_64__) || defined(__i386__)
+  if (getImplementation() == AVX2)
+  {
+    i = BulkBitfieldSimd::countAvx2(fullValues_, count_, rawMask, rawValue, matches);
+  }
+  else if (getImplementation() == SSSE3)
+  {
+    i = BulkBitfieldSimd::countSsse3(fullValues_, count_, rawMask, rawValue, matches);
+  }
+#endif
+  for (; i < count_; i++)
+  {
+    matches += ((fullValues_[i] & rawMask) == rawValue);
+  }
+  return (matches);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline size_t BulkBitfield::findFirstMatch(const T *fullValues_, size_t count_, unsigned lowOrderBit_, unsigned highOrderBit_, T bitfieldValue_)
+{
+#if defined(ERROR_CHECKING)
+  if (!isValid<T>(lowOrderBit_, highOrderBit_, bitfieldValue_))
+  {
+    return (count_);
+  }
+#endif
+  T rawMask = BitmapScan::toRaw((T)(getMask<T>(lowOrderBit_, highOrderBit_) << lowOrderBit_));
+  T rawValue = BitmapScan::toRaw((T)(bitfieldValue_ << lowOrderBit_)) & rawMask;
+  size_t i = 0;
+#if defined(__x86_64__) || defined(__i386__)
+  int lane = -1;
+  if (getImplementation() == AVX2)
+  {
+    i = BulkBitfieldSimd::findAvx2(fullValues_, count_, rawMask, rawValue, lane);
+  }
+  else if (getImplementation() == SSSE3)
+  {
+    i = BulkBitfieldSimd::findSsse3(fullValues_, count_, rawMask, rawValue, lane);
+  }
+  if (lane >= 0)
+  {
+    return (i + lane);
+  }
+#endif
+  for (; i < count_; i++)
+  {
+    if ((fullValues_[i] & rawMask) == rawValue)
+    {
+      return (i);
+    }
+  }
+  return (count_);
+}
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef BYTE_SWAP_COPY_H
+#define BYTE_SWAP_COPY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include <BitmapScan.h>
+#include <BulkBitfield.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// This module has the endian converting block copies between host values and
+// device registers for 16, 32, and 64-bit widths, e.g. for descriptor rings
+// and lookup tables written through a device, the host side values are the
+// endian adjusted values (as with getBitfield/setBitfield), the device side
+// is the raw register contents, i.e. the same conversion as HTONS/HTONL/
+// HTONLL, just done a block at a time.  These are used by the block APIs of
+// the MemoryMappedDevice classes, they are not generally called directly.
+//
+// The byte swap is done 16 (SSSE3) or 32 (AVX2) bytes at a time with a byte
+// shuffle (PSHUFB), using the same runtime instruction set selection as the
+// BulkBitfield kernels.  For RAM based regions the swapped vectors are stored
+// as-is.  For memory mapped HW, where every register access must be a single
+// access of the register width, the vectors are swapped into a small local
+// buffer and written out with one store per register, using non-temporal
+// (MOVNTI) stores for the 32 and 64-bit widths followed by a single SFENCE,
+// and read with one load per register.  When no swap is needed (e.g. a
+// FORCE_BIG_ENDIAN build) the copies are plain copies.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class ByteSwapCopy
+{
+  public:
+
+    // the kind of memory on the device side
+    enum Target
+    {
+      RAM,    // RAM based buffer, any access width is fine
+      MMIO    // memory mapped HW, one access of the register width per register
+    };
+
+    // swap count values from src to dst (RAM only), dst and src can be the same
+    template <typename T>
+    static void swap(T *dst_, const T *src_, size_t count_);
+
+    // write count host values to the device registers, converting them to the raw register order
+    template <typename T>
+    static void toDevice(volatile T *device_, const T *values_, size_t count_, Target target_);
+
+    // read count device registers into host values, converting them from the raw register order
+    template <typename T>
+    static void fromDevice(T *values_, const volatile T *device_, size_t count_, Target target_);
+
+    // return if the host and device byte orders differ, the conversion is the same
+    // in both directions, it is a compile time constant
+    template <typename T>
+    static bool needsSwap(void){return (BitmapScan::toLogical((T)1) != 1);};
+
+    // order the non-temporal stores before any later stores
+    static void fence(void);
+
+  private:
+
+    // values per local buffer of the MMIO paths
+    enum { CHUNK_BYTES = 256 };
+
+    // a single width-correct register store, non-temporal where there is one
+    template <typename T>
+    static void store(volatile T *address_, T value_);
+
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+
+namespace BulkBitfieldSimd
+{
+  template <typename T>
+  __attribute__((target("ssse3"))) inline size_t swapSsse3(T *dst_, const T *src_, size_t count_)
+  {
+    const size_t lanes = 16/sizeof(T);
+    const __m128i swap = getSwap128<T>();
+    size_t i = 0;
+    for (; (i + lanes) <= count_; i += lanes)
+    {
+      _mm_storeu_si128((__m128i *)&dst_[i], _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&src_[i]), swap));
+    }
+    return (i);
+  }
+
+  template <typename T>
+  __attribute__((target("avx2"))) inline size_t swapAvx2(T *dst_, const T *src_, size_t count_)
+  {
+    const size_t lanes = 32/sizeof(T);
+    const __m256i swap = getSwap256<T>();
+    size_t i = 0;
+    for (; (i + lanes) <= count_; i += lanes)
+    {
+      _mm256_storeu_si256((__m256i *)&dst_[i], _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)&src_[i]), swap));
+    }
+    return (i);
+  }
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void ByteSwapCopy::swap(T *dst_, const T *src_, size_t count_)
+{
+  size_t i = 0;
+#if defined(__x86_64__) || defined(__i386__)
+  if (BulkBitfield::getSelectedImplementation() == BulkBitfield::AVX2)
+  {
+    i = BulkBitfieldSimd::swapAvx2(dst_, src_, count_);
+  }
+  else if (BulkBitfield::getSelectedImplementation() == BulkBitfield::SSSE3)
+  {
+    i = BulkBitfieldSimd::swapSsse3(dst_, src_, count_);
+  }
+#endif
+  for (; i < count_; i++)
+  {
+    // the raw to logical conversion is a swap whenever needsSwap is true
+    dst_[i] = BitmapScan::toLogical(src_[i]);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void ByteSwapCopy::store(volatile T *address_, T value_)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  if (sizeof(T) == 4)
+  {
+    _mm_stream_si32((int *)address_, (int)value_);
+    return;
+  }
+#if defined(__x86_64__)
+  if (sizeof(T) == 8)
+  {
+    _mm_stream_si64((long long *)address_, (long long)value_);
+    return;
+  }
+#endif
+#endif
+  *address_ = value_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void ByteSwapCopy::fence(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_sfence();
+#else
+  __sync_synchronize();
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void ByteSwapCopy::toDevice(volatile T *device_, const T *values_, size_t count_, Target target_)
+{
+  if (target_ == RAM)
+  {
+    if (needsSwap<T>())
+    {
+      swap((T *)device_, values_, count_);
+    }
+    else
+    {
+      memcpy((void *)device_, values_, count_*sizeof(T));
+    }
+    return;
+  }
+
+  // swap a chunk at a time into a local buffer, then one store per register
+  T chunk[CHUNK_BYTES/sizeof(T)];
+  for (size_t base = 0; base < count_; base += CHUNK_BYTES/sizeof(T))
+  {
+    size_t count = ((count_ - base) < (CHUNK_BYTES/sizeof(T))) ? (count_ - base) : (CHUNK_BYTES/sizeof(T));
+    const T *values = &values_[base];
+    if (needsSwap<T>())
+    {
+      swap(chunk, values, count);
+      values = chunk;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+      store(&device_[base + i], values[i]);
+    }
+  }
+  fence();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void ByteSwapCopy::fromDevice(T *values_, const volatile T *device_, size_t count_, Target target_)
+{
+  if (target_ == RAM)
+  {
+    if (needsSwap<T>())
+    {
+      swap(values_, (const T *)device_, count_);
+    }
+    else
+    {
+      memcpy(values_, (const void *)device_, count_*sizeof(T));
+    }
+    return;
+  }
+
+  // one load per register straight into the host buffer, then swap it in place
+  for (size_t i = 0; i < count_; i++)
+  {
+    values_[i] = device_[i];
+  }
+  if (needsSwap<T>())
+  {
+    swap(values_, values_, count_);
+  }
+}
+
+#endif
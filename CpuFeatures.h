@@ -0,0 +1,53 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// This module has the runtime CPU feature checks used to pick between the
+// instruction set specific and the portable implementations of the bulk bit
+// banging functions, the checks are only done once and then cached.  On
+// non-x86 systems all the checks return false.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class CpuFeatures
+{
+  public:
+
+    static bool hasBmi2(void){static bool bmi2 = check(BMI2); return (bmi2);};
+    static bool hasSsse3(void){static bool ssse3 = check(SSSE3); return (ssse3);};
+    static bool hasAvx2(void){static bool avx2 = check(AVX2); return (avx2);};
+
+  private:
+
+    enum Feature
+    {
+      BMI2,
+      SSSE3,
+      AVX2
+    };
+
+    static bool check(Feature feature_);
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline bool CpuFeatures::check(Feature feature_)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  switch (feature_)
+  {
+    case BMI2:
+      return (__builtin_cpu_supports("bmi2"));
+    case SSSE3:
+      return (__builtin_cpu_supports("ssse3"));
+    case AVX2:
+      return (__builtin_cpu_supports("avx2"));
+  }
+#endif
+  return (false);
+}
+
+#endif
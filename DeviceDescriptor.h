@@ -0,0 +1,217 @@
+#ifndef DEVICE_DESCRIPTOR_H
+#define DEVICE_DESCRIPTOR_H
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <DeviceLog.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// This module has the constexpr device descriptors and the (lazy and batched)
+// mapping of the memory mapped devices.  A descriptor has everything needed
+// to construct and map a device, and can live in read-only data, e.g.
+//
+// constexpr DeviceDescriptor myQueueDescriptors[] =
+// {
+//   {"queue0", 0x80000000, 64, "/dev/mem"},
+//   {"queue1", 0x80000100, 64, "/dev/mem"},
+// };
+//
+// The names and device paths are string views of string literals, i.e. they
+// must be NUL terminated and outlive the devices, nothing is copied.  Devices
+// constructed with a device path are not mapped until their first register
+// access (or an explicit map), mapAll maps a whole set of devices up front,
+// opening each device path only once, and the file descriptor is closed as
+// soon as its devices are mapped (a mapping does not need it).
+//
+// The first access to a lazily mapped device can come from any number of
+// threads at once (e.g. a FieldWatcher thread and the application), the
+// device is mapped exactly once, the others wait for the mapping.
+//
+// The physical addresses do not have to be page aligned, e.g. sub-devices of
+// one larger device, the mapping starts at the page the address is in.
+//
+// A device can be mapped write-combining (e.g. for a table region loaded with
+// a TableLoader, see TableLoader.h), so the CPU can merge the stores into full
+// line bursts.  The memory type of a mapping is set by the kernel per device
+// file, not by the open flags, every device path is opened with O_SYNC (which
+// is what makes /dev/mem map uncached, without it /dev/mem maps cached RAM
+// and BARs write-back), so a write-combining device must have a PCI sysfs
+// resourceN_wc file as its device path, which the kernel maps write-combining,
+// any other device path is refused and the device is not mapped.  The stores
+// to a write-combining mapping can be merged and reordered, so never map
+// registers with access semantics this way, give the table region a device of
+// its own, e.g.
+//
+// constexpr DeviceDescriptor myTableDescriptor =
+//   {"table", 0, 0x100000, "/sys/bus/pci/devices/0000:03:00.0/resource2_wc", true};
+//
+////////////////////////////////////////////////////////////////////////////////
+
+struct DeviceDescriptor
+{
+  string_view name;
+  unsigned long address;    // physical address, or offset into the device
+  unsigned size;            // in registers
+  string_view device;       // e.g. "/dev/mem", empty if the address is used as-is
+  bool writeCombining = false;
+};
+
+class DeviceMapper
+{
+  public:
+
+    // open the device path for mapping (O_SYNC), a write-combining device path must be a
+    // PCI sysfs resourceN_wc file, returns -1 on failure
+    static int open(const char *name_, const char *device_, bool writeCombining_ = false);
+
+    // return if the device path is mapped write-combining by the kernel, i.e. a resourceN_wc file
+    static bool isWriteCombiningPath(const char *device_);
+
+    // map bytes at address of the device path, using memFd if it is already open (>= 0),
+    // returns the mapped address of the address (not of its page), or NULL on failure
+    static void *map(const char *name_, const char *device_, unsigned long address_, size_t bytes_, int memFd_ = -1, bool writeCombining_ = false);
+
+    // unmap an address returned by map
+    static void unmap(const char *name_, const char *device_, void *address_, size_t bytes_);
+
+    // map all the devices that have not been mapped yet, opening each device path
+    // once (once per mapping type), returns the number of devices that are mapped when done
+    template <class Device>
+    static unsigned mapAll(Device *const *devices_, unsigned count_);
+
+    // serializes the mapping of the devices, so concurrent first accesses to a device map it once
+    static mutex &getMutex(void){static mutex lock; return (lock);};
+
+  private:
+
+    static size_t getPageOffset(unsigned long address_){static const size_t pageSize = sysconf(_SC_PAGESIZE); return (address_ & (pageSize - 1));};
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline int DeviceMapper::open(const char *name_, const char *device_, bool writeCombining_)
+{
+  if (writeCombining_ && !isWriteCombiningPath(device_))
+  {
+    DeviceLog::log(DeviceLog::ERROR, "%s cannot map device: %s write-combining, not a resourceN_wc file", name_, device_);
+    return (-1);
+  }
+  int memFd = ::open(device_, O_RDWR | O_SYNC);
+  if (memFd < 0)
+  {
+    DeviceLog::log(DeviceLog::ERROR, "%s failed to open device: %s", name_, device_);
+  }
+  return (memFd);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline bool DeviceMapper::isWriteCombiningPath(const char *device_)
+{
+  size_t length = strlen(device_);
+  return ((length > 3) && (strcmp(&device_[length - 3], "_wc") == 0));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void *DeviceMapper::map(const char *name_, const char *device_, unsigned long address_, size_t bytes_, int memFd_, bool writeCombining_)
+{
+  int memFd = memFd_;
+  if (memFd < 0)
+  {
+    memFd = open(name_, device_, writeCombining_);
+    if (memFd < 0)
+    {
+      return (NULL);
+    }
+  }
+
+  size_t pageOffset = getPageOffset(address_);
+  void *address = mmap(NULL, bytes_ + pageOffset, PROT_READ | PROT_WRITE, MAP_SHARED, memFd, address_ - pageOffset);
+  if (memFd_ < 0)
+  {
+    close(memFd);
+  }
+
+  if (address == MAP_FAILED)
+  {
+    DeviceLog::log(DeviceLog::ERROR, "%s failed to map address: 0x%lx, size: %zu, on device: %s", name_, address_, bytes_, device_);
+    return (NULL);
+  }
+  DeviceLog::log(DeviceLog::INFO, "%s successfully mapped address: 0x%lx, size: %zu, on device: %s%s", name_, address_, bytes_, device_, writeCombining_ ? ", write-combining" : "");
+  return ((uint8_t *)address + pageOffset);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void DeviceMapper::unmap(const char *name_, const char *device_, void *address_, size_t bytes_)
+{
+  size_t pageOffset = getPageOffset((unsigned long)address_);
+  if (munmap((uint8_t *)address_ - pageOffset, bytes_ + pageOffset) == 0)
+  {
+    DeviceLog::log(DeviceLog::INFO, "%s successfully unmapped memory on device: %s", name_, device_);
+  }
+  else
+  {
+    DeviceLog::log(DeviceLog::ERROR, "%s failed to unmap memory on device: %s", name_, device_);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <class Device>
+inline unsigned DeviceMapper::mapAll(Device *const *devices_, unsigned count_)
+{
+  // group the devices that still need mapping by device path and mapping type
+  vector<Device *> devices;
+  devices.reserve(count_);
+  unsigned mapped = 0;
+  for (unsigned i = 0; i < count_; i++)
+  {
+    if (devices_[i]->isMemoryMapped())
+    {
+      mapped++;
+    }
+    else if (devices_[i]->getDevice()[0] != 0)
+    {
+      devices.push_back(devices_[i]);
+    }
+  }
+  auto key = [](Device *device_){return (make_pair(string_view(device_->getDevice()), device_->isWriteCombining()));};
+  sort(devices.begin(), devices.end(), [&key](Device *a_, Device *b_){return (key(a_) < key(b_));});
+
+  for (size_t first = 0; first < devices.size(); )
+  {
+    size_t last = first + 1;
+    while ((last < devices.size()) && (key(devices[last]) == key(devices[first])))
+    {
+      last++;
+    }
+    int memFd = open(devices[first]->getName(), devices[first]->getDevice(), devices[first]->isWriteCombining());
+    if (memFd >= 0)
+    {
+      for (size_t i = first; i < last; i++)
+      {
+        mapped += devices[i]->map(memFd);
+      }
+      close(memFd);
+    }
+    first = last;
+  }
+  return (mapped);
+}
+
+#endif
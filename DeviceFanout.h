@@ -0,0 +1,361 @@
+#ifndef DEVICE_FANOUT_H
+#define DEVICE_FANOUT_H
+
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <BitfieldMacros.h>
+#include <DeviceLog.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// This module has a fan-out executor that applies the same sequence of register
+// and bitfield operations (a program) to many identical device instances in
+// parallel on a pool of worker threads, e.g. configuring all the ASICs of a
+// line card at boot.  The executor is a template on the device class, which
+// can be any of the MemoryMappedDevice classes or a class derived from them,
+// e.g.
+//
+// DeviceFanout<My32BitDevice> fanout;
+// DeviceFanout<My32BitDevice>::Program program;
+// program.push_back(DeviceFanout<My32BitDevice>::setRegister(MY_32BIT_REG1, 0));
+// program.push_back(DeviceFanout<My32BitDevice>::setBitfieldParameter(MY_32BIT_REG0, MY_32BIT_REG0_BITFIELD3, 0));
+// fanout.execute(devices, program, parameters, results);
+//
+// Any step value can be substituted per device from that device's parameter
+// list, and each device gets its own result with the values of all the get
+// steps in program order, or the error for the first step that failed, the
+// remaining steps are not applied to a device once one of its steps fails.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+template <class Device>
+class DeviceFanout
+{
+  public:
+
+    // the register value type of the device, i.e. uint8_t, uint16_t, or uint32_t
+    typedef decltype(declval<Device &>().getRegister(0)) Value;
+
+    enum Operation
+    {
+      SET_REGISTER,
+      GET_REGISTER,
+      SET_BITFIELD,
+      GET_BITFIELD
+    };
+
+    // value of a step parameter index when the step value is used as-is
+    enum { NO_PARAMETER = ~0u };
+
+    // single program step, if the parameter index is set, the value is taken from
+    // the parameter list of each device at that index instead of the step value
+    struct Step
+    {
+      Operation operation;
+      unsigned register_;
+      unsigned lowOrderBit;
+      unsigned highOrderBit;
+      Value value;
+      unsigned parameter;
+    };
+
+    typedef vector<Step> Program;
+    typedef vector<Value> Parameters;
+
+    // per-device result, the values are from all the get steps in program order
+    struct Result
+    {
+      bool success;
+      unsigned failedStep;
+      string error;
+      vector<Value> values;
+    };
+
+    // start the worker threads, by default one per CPU, the calling thread
+    // of execute() also works on the devices so it is never idle
+    DeviceFanout(unsigned numThreads_ = 0);
+    ~DeviceFanout();
+
+    // apply the program to all the devices, the parameters are either empty (no parameter
+    // substitution) or have one entry per device, returns true if all the devices succeeded
+    bool execute(vector<Device *> &devices_, const Program &program_, const vector<Parameters> &parameters_, vector<Result> &results_);
+    bool execute(vector<Device *> &devices_, const Program &program_, vector<Result> &results_){return (execute(devices_, program_, vector<Parameters>(), results_));};
+
+    // return the number of worker threads, not including the caller of execute()
+    unsigned getNumThreads(void){return (_threads.size());};
+
+    // program step builders
+    static Step setRegister(unsigned register_, Value value_){return (makeStep(SET_REGISTER, register_, 0, 0, value_, NO_PARAMETER));};
+    static Step setRegisterParameter(unsigned register_, unsigned parameter_){return (makeStep(SET_REGISTER, register_, 0, 0, 0, parameter_));};
+    static Step getRegister(unsigned register_){return (makeStep(GET_REGISTER, register_, 0, 0, 0, NO_PARAMETER));};
+    static Step setBitfield(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, Value value_){return (makeStep(SET_BITFIELD, register_, lowOrderBit_, highOrderBit_, value_, NO_PARAMETER));};
+    static Step setBitfieldParameter(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, unsigned parameter_){return (makeStep(SET_BITFIELD, register_, lowOrderBit_, highOrderBit_, 0, parameter_));};
+    static Step getBitfield(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_){return (makeStep(GET_BITFIELD, register_, lowOrderBit_, highOrderBit_, 0, NO_PARAMETER));};
+
+  private:
+
+    static Step makeStep(Operation operation_, unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, Value value_, unsigned parameter_);
+
+    // run the program on a single device
+    void executeDevice(unsigned index_);
+
+    // keep taking devices from the current job until there are none left
+    void drainJob(void);
+
+    // worker thread main loop
+    void worker(void);
+
+    vector<thread> _threads;
+    mutex _lock;
+    condition_variable _start;
+    condition_variable _finish;
+    bool _shutdown;
+
+    // the current job, only valid while an execute() is in progress
+    uint64_t _generation;
+    vector<Device *> *_devices;
+    const Program *_program;
+    const vector<Parameters> *_parameters;
+    vector<Result> *_results;
+    atomic<unsigned> _next;
+    atomic<unsigned> _remaining;
+    unsigned _active;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <class Device>
+inline DeviceFanout<Device>::DeviceFanout(unsigned numThreads_) : _shutdown(false), _generation(0), _devices(NULL), _program(NULL), _parameters(NULL), _results(NULL), _next(0), _remaining(0), _active(0)
+{
+  if (numThreads_ == 0)
+  {
+    // the calling thread is one of the workers
+    numThreads_ = thread::hardware_concurrency();
+    numThreads_ = (numThreads_ > 1) ? (numThreads_-1) : 0;
+  }
+  for (unsigned i = 0; i < numThreads_; i++)
+  {
+    _threads.push_back(thread(&DeviceFanout::worker, this));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <class Device>
+inline DeviceFanout<Device>::~DeviceFanout()
+{
+  {
+    lock_guard<mutex> guard(_lock);
+    _shutdown = true;
+  }
+  _start.notify_all();
+  for (unsigned i = 0; i < _threads.size(); i++)
+  {
+    _threads[i].join();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <class Device>
+inline typename DeviceFanout<Device>::Step DeviceFanout<Device>::makeStep(Operation operation_, unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, Value value_, unsigned parameter_)
+{
+  Step step;
+  step.operation = operation_;
+  step.register_ = register_;
+  step.lowOrderBit = lowOrderBit_;
+  step.highOrderBit = highOrderBit_;
+  step.value = value_;
+  step.parameter = parameter_;
+  return (step);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <class Device>
+inline void DeviceFanout<Device>::executeDevice(unsigned index_)
+{
+  Device &device = *(*_devices)[index_];
+  Result &result = (*_results)[index_];
+  const Program &program = *_program;
+  const unsigned numBits = sizeof(Value)*8;
+  char error[128] = {0};
+
+  result.success = false;
+  result.failedStep = 0;
+  result.error.clear();
+  result.values.clear();
+
+  // map a lazily mapped device now, from its own worker, rather than on its first step
+  if (!device.map())
+  {
+    snprintf(error, sizeof(error), "device: %s, is not memory mapped", device.getName());
+    result.error = error;
+    return;
+  }
+
+  for (unsigned i = 0; i < program.size(); i++)
+  {
+    const Step &step = program[i];
+    Value value = step.value;
+    result.failedStep = i;
+
+    // validate the step against this device, parameter substitution first so it is validated too
+    if (step.parameter != NO_PARAMETER)
+    {
+      if ((_parameters->size() <= index_) || ((*_parameters)[index_].size() <= step.parameter))
+      {
+        snprintf(error, sizeof(error), "step: %d, parameter: %d, not provided for device: %s", i, step.parameter, device.getName());
+        result.error = error;
+        return;
+      }
+      value = (*_parameters)[index_][step.parameter];
+    }
+    if (step.register_ >= device.getSize())
+    {
+      snprintf(error, sizeof(error), "step: %d, register: %d, exceeds memory mapped size: %d", i, step.register_, device.getSize());
+    }
+    else if (((step.operation == SET_BITFIELD) || (step.operation == GET_BITFIELD)) &&
+             ((step.lowOrderBit > step.highOrderBit) || (step.highOrderBit > (numBits-1))))
+    {
+      snprintf(error, sizeof(error), "step: %d, invalid bitfield: %d-%d, for %d-bit value", i, step.lowOrderBit, step.highOrderBit, numBits);
+    }
+    else if ((step.operation == SET_BITFIELD) && (value > (uint32_t)((1ULL << (step.highOrderBit - step.lowOrderBit + 1)) - 1)))
+    {
+      // 64-bit shift, a full width (e.g. 0-31) field would shift a 32-bit 1 out of range
+      snprintf(error, sizeof(error), "step: %d, value: %u, exceeds max bitfield value: %u", i, (unsigned)value, (uint32_t)((1ULL << (step.highOrderBit - step.lowOrderBit + 1)) - 1));
+    }
+    if (error[0] != 0)
+    {
+      result.error = error;
+      return;
+    }
+
+    switch (step.operation)
+    {
+      case SET_REGISTER:
+        device.setRegister(step.register_, value);
+        break;
+      case GET_REGISTER:
+        result.values.push_back(device.getRegister(step.register_));
+        break;
+      case SET_BITFIELD:
+        device.setBitfield(step.register_, step.lowOrderBit, step.highOrderBit, value);
+        break;
+      case GET_BITFIELD:
+        result.values.push_back(device.getBitfield(step.register_, step.lowOrderBit, step.highOrderBit));
+        break;
+    }
+  }
+  result.success = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <class Device>
+inline void DeviceFanout<Device>::drainJob(void)
+{
+  unsigned numDevices = _devices->size();
+  for (;;)
+  {
+    unsigned index = _next.fetch_add(1, memory_order_relaxed);
+    if (index >= numDevices)
+    {
+      return;
+    }
+    executeDevice(index);
+    _remaining.fetch_sub(1, memory_order_acq_rel);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <class Device>
+inline void DeviceFanout<Device>::worker(void)
+{
+  uint64_t generation = 0;
+  for (;;)
+  {
+    {
+      unique_lock<mutex> guard(_lock);
+      _start.wait(guard, [&]{return (_shutdown || (_generation != generation));});
+      if (_shutdown)
+      {
+        return;
+      }
+      generation = _generation;
+      if (_devices == NULL)
+      {
+        // woke up too late, the job is already done
+        continue;
+      }
+      _active++;
+    }
+    drainJob();
+    {
+      // the caller of execute() waits for every worker that joined the job, not just
+      // for the devices to be done, so nobody touches the job after it has returned
+      lock_guard<mutex> guard(_lock);
+      _active--;
+    }
+    _finish.notify_all();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <class Device>
+inline bool DeviceFanout<Device>::execute(vector<Device *> &devices_, const Program &program_, const vector<Parameters> &parameters_, vector<Result> &results_)
+{
+  results_.clear();
+  results_.resize(devices_.size());
+  if (devices_.empty())
+  {
+    return (true);
+  }
+  if (!parameters_.empty() && (parameters_.size() != devices_.size()))
+  {
+    DeviceLog::log(DeviceLog::ERROR, "FANOUT: number of parameter lists: %d, does not match number of devices: %d", (unsigned)parameters_.size(), (unsigned)devices_.size());
+    return (false);
+  }
+
+  // publish the job and kick the workers
+  {
+    lock_guard<mutex> guard(_lock);
+    _devices = &devices_;
+    _program = &program_;
+    _parameters = &parameters_;
+    _results = &results_;
+    _next.store(0, memory_order_relaxed);
+    _remaining.store(devices_.size(), memory_order_relaxed);
+    _generation++;
+  }
+  _start.notify_all();
+
+  // help out, then wait for the stragglers
+  drainJob();
+  {
+    unique_lock<mutex> guard(_lock);
+    _finish.wait(guard, [&]{return ((_remaining.load(memory_order_acquire) == 0) && (_active == 0));});
+    _devices = NULL;
+  }
+
+  bool success = true;
+  for (unsigned i = 0; i < results_.size(); i++)
+  {
+    success = success && results_[i].success;
+  }
+  return (success);
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef DEVICE_LOG_H
+#define DEVICE_LOG_H
+
+#include <stdio.h>
+#include <stdarg.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// This module has the configurable log sink for the device mapping messages
+// (map/unmap INFO and ERROR messages) and the ERROR messages of the broker,
+// fan-out, program, bitmap, bitfield set, bulk bitfield, field wait, and
+// field watcher modules, by default they go to stdout as they always have, a
+// program can install its own sink, e.g. to send them to its own logger, or
+// set a NULL sink to drop them, in which case the messages are not even
+// formatted.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class DeviceLog
+{
+  public:
+
+    enum Level
+    {
+      INFO,
+      ERROR
+    };
+
+    // the message is fully formatted, without a trailing newline
+    typedef void (*Sink)(Level level_, const char *message_);
+
+    // set the sink for all devices, NULL drops all the messages
+    static void setSink(Sink sink_){getSink() = sink_;};
+
+    // format and send a message to the sink
+    static void log(Level level_, const char *format_, ...) __attribute__((format(printf, 2, 3)));
+
+  private:
+
+    enum { MAX_MESSAGE_SIZE = 256 };
+
+    static void printSink(Level level_, const char *message_){printf("%s: %s\n", (level_ == ERROR) ? "ERROR" : "INFO", message_);};
+    static Sink &getSink(void){static Sink sink = printSink; return (sink);};
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void DeviceLog::log(Level level_, const char *format_, ...)
+{
+  Sink sink = getSink();
+  if (sink == NULL)
+  {
+    return;
+  }
+  char message[MAX_MESSAGE_SIZE];
+  va_list args;
+  va_start(args, format_);
+  vsnprintf(message, sizeof(message), format_, args);
+  va_end(args);
+  sink(level_, message);
+}
+
+#endif
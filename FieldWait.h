@@ -0,0 +1,407 @@
+#ifndef FIELD_WAIT_H
+#define FIELD_WAIT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <BitmapScan.h>
+#include <DeviceLog.h>
+
+// the coroutine API needs C++20, e.g. -std=c++20, without it this module is empty
+#if defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <exception>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// This module has the C++20 coroutine based asynchronous bitfield waits, for
+// waiting on many independent HW conditions (e.g. per queue completions across
+// many devices) without a thread or a hand written state machine per wait.  A
+// coroutine suspends on a condition with
+//
+// bool done = co_await my32BitDevice.fieldEquals(MY_32BIT_REG0, MY_32BIT_REG0_BITFIELD1, 1);
+//
+// and a single FieldWaitScheduler resumes it once the condition holds (true),
+// or the optional timeout expires (false).  Each scheduler sweep reads every
+// register that has any pending waits exactly once, no matter how many waits
+// (from how many coroutines) are on fields of it, evaluates all the waits on
+// it, and then resumes the satisfied waiters, so the number of HW reads per
+// sweep is the number of distinct registers, not the number of waits.
+//
+// Coroutines that wait must return FieldWaitTask, they start running right
+// away and run up to their first wait, e.g.
+//
+// FieldWaitTask waitForQueue(MemoryMappedDevice32 &device_, unsigned queue_)
+// {
+//   bool done = co_await device_.fieldEquals(QUEUE_STATUS_REG, queue_, queue_, 1, 1000);
+//   if (done)
+//   {
+//     ...
+//   }
+// }
+//
+// The state of each wait (the coroutine, condition, deadline, and result) is
+// kept in a node owned by the scheduler from the start of the wait until the
+// coroutine has been resumed, the awaiter only points at it, so the scheduler
+// never depends on where (or how long) the awaiter lives, e.g.
+//
+// if (co_await device_.fieldEquals(QUEUE_STATUS_REG, queue_, queue_, 1, 1000))
+//
+// The nodes are recycled, so a steady state of waits does not allocate.
+//
+// Note, g++ 12 lays out the frame of a coroutine whose only value kept across
+// a suspension is the condition of such an if (or while) wrong, and it crashes
+// on resume, no matter what the awaiter is, any other local that is used after
+// the co_await (e.g. a counter) avoids it.
+//
+// The scheduler is not thread safe, the waits must be started, and the
+// scheduler polled/run, from the same thread, i.e. every waiting coroutine
+// runs on the scheduler thread.  The device fieldEquals functions use the
+// default (process wide) scheduler, use FieldWaitScheduler::fieldEquals
+// directly for a separate one.
+//
+// cancelAll resumes all the pending waits with false, e.g. before the devices
+// they wait on go away.  A scheduler that is destroyed with waits still
+// pending (e.g. the default one at exit) destroys their coroutines without
+// resuming them.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class FieldWaitScheduler;
+
+// coroutine return type for coroutines that wait on fields, the coroutine
+// frame frees itself when the coroutine finishes
+struct FieldWaitTask
+{
+  struct promise_type
+  {
+    FieldWaitTask get_return_object(void){return (FieldWaitTask());};
+    suspend_never initial_suspend(void){return (suspend_never());};
+    suspend_never final_suspend(void) noexcept {return (suspend_never());};
+    void return_void(void){};
+    void unhandled_exception(void){terminate();};
+  };
+};
+
+// the state of a single wait, owned by the scheduler
+struct FieldWaitState
+{
+  // read the register and return its endian adjusted value
+  typedef uint32_t (*Reader)(void *device_, unsigned register_);
+
+  void *device;
+  Reader reader;
+  unsigned register_;
+  uint32_t mask;      // endian adjusted, shifted
+  uint32_t value;     // endian adjusted, shifted
+  uint64_t deadline;  // nsec, 0 for no timeout
+  bool result;
+  coroutine_handle<> handle;
+};
+
+// the awaitable returned by fieldEquals, resumes with true if the condition was
+// met, or false if it timed out (or the wait was invalid), the awaiter only has
+// the wait parameters until it is awaited, and then the address of the state
+class FieldWaitAwaiter
+{
+  public:
+
+    typedef FieldWaitState::Reader Reader;
+
+    FieldWaitAwaiter() : _scheduler(NULL), _wait(), _state(NULL) {};
+    FieldWaitAwaiter(FieldWaitScheduler *scheduler_, const FieldWaitState &wait_) : _scheduler(scheduler_), _wait(wait_), _state(NULL) {};
+
+    // always suspend, the condition is evaluated by the next scheduler sweep with the other waits on the register
+    bool await_ready(void){return (_scheduler == NULL);};
+    void await_suspend(coroutine_handle<> handle_);
+    bool await_resume(void){return ((_state != NULL) && _state->result);};
+
+  private:
+
+    FieldWaitScheduler *_scheduler;   // NULL for an invalid wait
+    FieldWaitState _wait;             // the wait parameters
+    FieldWaitState *_state;           // the scheduler's state of the wait, valid until the resume returns
+
+};
+
+class FieldWaitScheduler
+{
+  public:
+
+    FieldWaitScheduler() : _pending(0), _reads(0), _sweepIntervalUsec(0) {};
+    ~FieldWaitScheduler();
+
+    // return the process wide scheduler used by the device fieldEquals functions
+    static FieldWaitScheduler &getDefault(void){static FieldWaitScheduler scheduler; return (scheduler);};
+
+    // return an awaitable that waits until the bitfield of the register equals the value,
+    // for up to timeoutUsec (0 waits forever), the device can be any of the device classes
+    template <class Device>
+    FieldWaitAwaiter fieldEquals(Device &device_, unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, uint32_t value_, unsigned timeoutUsec_ = 0);
+
+    // do a single sweep, read each register with pending waits once, and resume all the
+    // waiters whose condition holds or whose timeout expired, returns the number resumed
+    unsigned poll(void);
+
+    // sweep until there are no more pending waits, sleeping the sweep interval between sweeps
+    void run(void);
+
+    // resume all the pending waits with false (as if they timed out), returns the number resumed,
+    // waits started by the resumed coroutines are pending for the next sweep
+    unsigned cancelAll(void);
+
+    // set the time between the sweeps of run, 0 (the default) sweeps continuously
+    void setSweepInterval(unsigned usec_){_sweepIntervalUsec = usec_;};
+
+    // return the number of pending waits, and the total number of register reads done
+    unsigned getPendingCount(void){return (_pending);};
+    uint64_t getReadCount(void){return (_reads);};
+
+  private:
+
+    friend class FieldWaitAwaiter;
+
+    // all the pending waits on a single register of a single device
+    struct Group
+    {
+      FieldWaitState::Reader reader;
+      vector<FieldWaitState *> waiters;
+    };
+
+    typedef pair<void *, unsigned> Key;
+
+    // the states are allocated in blocks, and recycled
+    enum { STATE_BLOCK_SIZE = 256 };
+
+    static uint64_t getNsec(void);
+
+    // start a wait, the scheduler owns the state until the waiter has been resumed
+    FieldWaitState *add(const FieldWaitState &wait_, coroutine_handle<> handle_);
+
+    // resume the waiters, and recycle their states once each resume has returned
+    unsigned resume(vector<FieldWaitState *> &ready_);
+
+    // the groups are ordered by device and register, so each sweep reads each
+    // device's registers in ascending order
+    map<Key, Group> _groups;
+    vector<FieldWaitState *> _ready;
+    vector<FieldWaitState *> _free;
+    vector<unique_ptr<FieldWaitState[]>> _stateBlocks;
+    unsigned _pending;
+    uint64_t _reads;
+    unsigned _sweepIntervalUsec;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void FieldWaitAwaiter::await_suspend(coroutine_handle<> handle_)
+{
+  // the scheduler never touches the awaiter, the state is recycled after the resume returns
+  _state = _scheduler->add(_wait, handle_);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <class Device>
+inline FieldWaitAwaiter FieldWaitScheduler::fieldEquals(Device &device_, unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, uint32_t value_, unsigned timeoutUsec_)
+{
+  typedef decltype(device_.getRegister(0)) RegisterValue;
+  FieldWaitAwaiter::Reader reader = [](void *device_, unsigned register_) -> uint32_t
+  {
+    return (BitmapScan::toLogical(((Device *)device_)->getRegister(register_)));
+  };
+#if defined(ERROR_CHECKING)
+  if ((lowOrderBit_ > highOrderBit_) || (highOrderBit_ >= sizeof(RegisterValue)*8) || (register_ >= device_.getSize()))
+  {
+    DeviceLog::log(DeviceLog::ERROR, "device: %s, FIELD WAIT: invalid register: %d, bitfield: %d-%d", device_.getName(), register_, lowOrderBit_, highOrderBit_);
+    // no scheduler, i.e. completes right away with false
+    return (FieldWaitAwaiter());
+  }
+#endif
+  uint32_t mask = (uint32_t)((((uint64_t)1 << (highOrderBit_ - lowOrderBit_ + 1)) - 1) << lowOrderBit_);
+  FieldWaitState wait;
+  wait.device = &device_;
+  wait.reader = reader;
+  wait.register_ = register_;
+  wait.mask = mask & (uint32_t)(RegisterValue)~0u;
+  wait.value = (value_ << lowOrderBit_) & mask;
+  wait.deadline = (timeoutUsec_ != 0) ? (getNsec() + (uint64_t)timeoutUsec_*1000) : 0;
+  wait.result = false;
+  return (FieldWaitAwaiter(this, wait));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline uint64_t FieldWaitScheduler::getNsec(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec*1000000000ULL + now.tv_nsec);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline FieldWaitState *FieldWaitScheduler::add(const FieldWaitState &wait_, coroutine_handle<> handle_)
+{
+  FieldWaitState *state;
+  if (_free.empty())
+  {
+    _stateBlocks.emplace_back(new FieldWaitState[STATE_BLOCK_SIZE]);
+    for (unsigned i = STATE_BLOCK_SIZE; i > 0; i--)
+    {
+      _free.push_back(&_stateBlocks.back()[i - 1]);
+    }
+  }
+  state = _free.back();
+  _free.pop_back();
+  *state = wait_;
+  state->handle = handle_;
+  Group &group = _groups[Key(state->device, state->register_)];
+  group.reader = state->reader;
+  group.waiters.push_back(state);
+  _pending++;
+  return (state);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline unsigned FieldWaitScheduler::resume(vector<FieldWaitState *> &ready_)
+{
+  // the resumed coroutines can poll, cancel, or start new waits, none of which touch ready_
+  unsigned resumed = ready_.size();
+  _pending -= resumed;
+  for (unsigned i = 0; i < resumed; i++)
+  {
+    ready_[i]->handle.resume();
+    _free.push_back(ready_[i]);
+  }
+  ready_.clear();
+  return (resumed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline unsigned FieldWaitScheduler::poll(void)
+{
+  // only look at the clock if there are any timeouts, checked once per sweep
+  uint64_t now = 0;
+  bool timeouts = false;
+
+  // evaluate all the waits first, the waiters are resumed after all the reads, so any
+  // new waits they start go into the next sweep and cannot invalidate this one
+  _ready.clear();
+  for (auto group = _groups.begin(); group != _groups.end(); )
+  {
+    vector<FieldWaitState *> &waiters = group->second.waiters;
+    uint32_t value = group->second.reader(group->first.first, group->first.second);
+    _reads++;
+    for (size_t i = 0; i < waiters.size(); )
+    {
+      FieldWaitState *state = waiters[i];
+      bool done = ((value & state->mask) == state->value);
+      if (!done && (state->deadline != 0))
+      {
+        if (!timeouts)
+        {
+          now = getNsec();
+          timeouts = true;
+        }
+        if (now >= state->deadline)
+        {
+          _ready.push_back(state);
+          waiters[i] = waiters.back();
+          waiters.pop_back();
+          continue;
+        }
+      }
+      if (done)
+      {
+        state->result = true;
+        _ready.push_back(state);
+        waiters[i] = waiters.back();
+        waiters.pop_back();
+        continue;
+      }
+      i++;
+    }
+    if (waiters.empty())
+    {
+      group = _groups.erase(group);
+    }
+    else
+    {
+      ++group;
+    }
+  }
+
+  // now resume them, from a local vector, as a resumed coroutine can poll or cancel again
+  vector<FieldWaitState *> ready;
+  ready.swap(_ready);
+  unsigned resumed = resume(ready);
+  ready.swap(_ready);
+  return (resumed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline FieldWaitScheduler::~FieldWaitScheduler()
+{
+  // the suspended coroutines can never be resumed now, free their frames, which also
+  // drops any references they hold, e.g. to devices that may already be gone
+  for (auto group = _groups.begin(); group != _groups.end(); ++group)
+  {
+    for (size_t i = 0; i < group->second.waiters.size(); i++)
+    {
+      group->second.waiters[i]->handle.destroy();
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline unsigned FieldWaitScheduler::cancelAll(void)
+{
+  // take all the waiters first, resuming them can start new waits
+  _ready.clear();
+  for (auto group = _groups.begin(); group != _groups.end(); ++group)
+  {
+    _ready.insert(_ready.end(), group->second.waiters.begin(), group->second.waiters.end());
+  }
+  _groups.clear();
+
+  vector<FieldWaitState *> cancelled;
+  cancelled.swap(_ready);
+  for (size_t i = 0; i < cancelled.size(); i++)
+  {
+    cancelled[i]->result = false;
+  }
+  return (resume(cancelled));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void FieldWaitScheduler::run(void)
+{
+  while (_pending != 0)
+  {
+    poll();
+    if ((_sweepIntervalUsec != 0) && (_pending != 0))
+    {
+      usleep(_sweepIntervalUsec);
+    }
+  }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,381 @@
+#ifndef FIELD_WATCHER_H
+#define FIELD_WATCHER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <sched.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <BitmapScan.h>
+#include <DeviceLog.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// This module has a background bitfield watcher, one thread samples a set of
+// registered bitfields (of any number of devices) at a fixed rate, and
+// publishes every change of a bitfield value as an event (timestamp, field,
+// old value, new value) to all the subscribers, so several monitors of the
+// same status registers share one set of HW reads instead of each polling on
+// its own schedule.  Each sweep reads every register with watched bitfields
+// in it exactly once, no matter how many of its bitfields are watched.
+//
+// Each subscriber has its own lock-free single producer (the watcher thread)
+// single consumer (the subscriber) event queue, a subscriber that falls
+// behind loses the events that do not fit in its queue (they are counted),
+// the watcher never blocks on a subscriber.  The first sweep of a field only
+// records its initial value, it does not generate an event, e.g.
+//
+// FieldWatcher watcher(1000);   // sweep every 1000 usec
+// int linkUp = watcher.addField(my32BitDevice, MY_32BIT_REG0, MY_32BIT_REG0_BITFIELD1);
+// FieldWatcher::Subscriber *subscriber = watcher.subscribe();
+// watcher.start();
+// ...
+// FieldWatcher::Event event;
+// while (subscriber->pop(event)) {...}
+//
+// Fields are added while the watcher is stopped, subscribers can be added
+// (up to MAX_SUBSCRIBERS) and removed at any time.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class FieldWatcher
+{
+  public:
+
+    enum
+    {
+      MAX_SUBSCRIBERS = 16,
+      QUEUE_SIZE      = 1024    // events per subscriber queue, must be a power of 2
+    };
+
+    // a single bitfield change, the values are endian adjusted bitfield values
+    struct Event
+    {
+      uint64_t timestamp;   // CLOCK_MONOTONIC nsec of the sweep that found the change
+      unsigned field;       // as returned by addField
+      uint32_t oldValue;
+      uint32_t newValue;
+    };
+
+    // per subscriber event queue, the counters are on their own cache lines so
+    // the watcher and the subscriber never write the same line
+    class Subscriber
+    {
+      public:
+
+        // get the next event, returns false if there is none
+        bool pop(Event &event_);
+
+        // return the number of events lost because the queue was full
+        uint64_t getDropped(void){return (_dropped.load(memory_order_relaxed));};
+
+      private:
+
+        friend class FieldWatcher;
+
+        Subscriber() : _claimed(false), _active(false), _head(0), _tail(0), _dropped(0) {};
+
+        // called by the watcher thread only
+        void push(const Event &event_);
+
+        atomic<bool> _claimed;                    // owned by a subscriber
+        alignas(64) atomic<bool> _active;         // receiving events
+        alignas(64) atomic<uint64_t> _head;      // written by the watcher only
+        alignas(64) atomic<uint64_t> _tail;      // written by the subscriber only
+        alignas(64) atomic<uint64_t> _dropped;
+        Event _events[QUEUE_SIZE];
+    };
+
+    // sample every periodUsec, 0 samples continuously
+    FieldWatcher(unsigned periodUsec_) : _periodUsec(periodUsec_), _running(false), _sweepSequence(0), _sweeps(0), _reads(0) {};
+    ~FieldWatcher(){stop();};
+
+    // watch a bitfield of a register of a device, returns the field number used in the
+    // events, or -1 if the watcher is running, the device can be any of the device classes
+    template <class Device>
+    int addField(Device &device_, unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_);
+
+    // return a new subscriber, or NULL if there are already MAX_SUBSCRIBERS,
+    // the subscriber gets the events of all the changes after this call
+    Subscriber *subscribe(void);
+
+    // stop delivering events to the subscriber, its queue is reused by a later subscribe, waits
+    // for a sweep in progress to finish, so no event of it can reach a later subscriber
+    void unsubscribe(Subscriber *subscriber_);
+
+    // start/stop the watcher thread
+    bool start(void);
+    void stop(void);
+
+    // do a single sweep from the calling thread, for use without the watcher thread,
+    // returns the number of changes found
+    unsigned sweep(void);
+
+    // return the number of sweeps and register reads done
+    uint64_t getSweepCount(void){return (_sweeps.load(memory_order_relaxed));};
+    uint64_t getReadCount(void){return (_reads.load(memory_order_relaxed));};
+
+  private:
+
+    // read the register and return its endian adjusted value
+    typedef uint32_t (*Reader)(void *device_, unsigned register_);
+
+    // a watched bitfield, and the last value seen
+    struct Field
+    {
+      unsigned lowOrderBit;
+      uint32_t mask;          // unshifted
+      uint32_t value;
+      bool initialized;       // false until the first sweep after the field was added
+    };
+
+    // a register with watched bitfields in it, read once per sweep
+    struct Register
+    {
+      void *device;
+      Reader reader;
+      unsigned register_;
+      vector<unsigned> fields;
+    };
+
+    static uint64_t getNsec(void);
+
+    void run(void);
+
+    unsigned _periodUsec;
+    vector<Field> _fields;
+    vector<Register> _registers;
+    Subscriber _subscribers[MAX_SUBSCRIBERS];
+    atomic<bool> _running;
+    atomic<uint64_t> _sweepSequence;    // odd while a sweep is publishing events
+    thread _thread;
+    atomic<uint64_t> _sweeps;
+    atomic<uint64_t> _reads;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline bool FieldWatcher::Subscriber::pop(Event &event_)
+{
+  uint64_t tail = _tail.load(memory_order_relaxed);
+  if (tail == _head.load(memory_order_acquire))
+  {
+    return (false);
+  }
+  event_ = _events[tail & (QUEUE_SIZE-1)];
+  _tail.store(tail + 1, memory_order_release);
+  return (true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void FieldWatcher::Subscriber::push(const Event &event_)
+{
+  uint64_t head = _head.load(memory_order_relaxed);
+  if ((head - _tail.load(memory_order_acquire)) >= QUEUE_SIZE)
+  {
+    _dropped.fetch_add(1, memory_order_relaxed);
+    return;
+  }
+  _events[head & (QUEUE_SIZE-1)] = event_;
+  _head.store(head + 1, memory_order_release);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <class Device>
+inline int FieldWatcher::addField(Device &device_, unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_)
+{
+  typedef decltype(device_.getRegister(0)) RegisterValue;
+  if (_running.load(memory_order_relaxed))
+  {
+    DeviceLog::log(DeviceLog::ERROR, "device: %s, FIELD WATCHER: fields cannot be added while running", device_.getName());
+    return (-1);
+  }
+#if defined(ERROR_CHECKING)
+  if ((lowOrderBit_ > highOrderBit_) || (highOrderBit_ >= sizeof(RegisterValue)*8) || (register_ >= device_.getSize()))
+  {
+    DeviceLog::log(DeviceLog::ERROR, "device: %s, FIELD WATCHER: invalid register: %d, bitfield: %d-%d", device_.getName(), register_, lowOrderBit_, highOrderBit_);
+    return (-1);
+  }
+#endif
+
+  // find the register, or add it if this is its first watched bitfield
+  unsigned reg = 0;
+  for (; reg < _registers.size(); reg++)
+  {
+    if ((_registers[reg].device == (void *)&device_) && (_registers[reg].register_ == register_))
+    {
+      break;
+    }
+  }
+  if (reg == _registers.size())
+  {
+    Register newRegister;
+    newRegister.device = &device_;
+    newRegister.reader = [](void *device_, unsigned register_) -> uint32_t
+    {
+      return (BitmapScan::toLogical(((Device *)device_)->getRegister(register_)));
+    };
+    newRegister.register_ = register_;
+    _registers.push_back(newRegister);
+  }
+
+  Field field;
+  field.lowOrderBit = lowOrderBit_;
+  field.mask = (uint32_t)(((uint64_t)1 << (highOrderBit_ - lowOrderBit_ + 1)) - 1) & (uint32_t)(RegisterValue)~0u;
+  field.value = 0;
+  field.initialized = false;
+  _fields.push_back(field);
+  _registers[reg].fields.push_back(_fields.size() - 1);
+  return (_fields.size() - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline FieldWatcher::Subscriber *FieldWatcher::subscribe(void)
+{
+  for (unsigned i = 0; i < MAX_SUBSCRIBERS; i++)
+  {
+    Subscriber &subscriber = _subscribers[i];
+    bool claimed = false;
+    if (!subscriber._claimed.load(memory_order_relaxed) && subscriber._claimed.compare_exchange_strong(claimed, true, memory_order_acq_rel))
+    {
+      // drop anything left over from a previous subscriber before the watcher sees it active
+      subscriber._tail.store(subscriber._head.load(memory_order_acquire), memory_order_release);
+      subscriber._dropped.store(0, memory_order_relaxed);
+      subscriber._active.store(true, memory_order_release);
+      return (&subscriber);
+    }
+  }
+  DeviceLog::log(DeviceLog::ERROR, "FIELD WATCHER: no free subscribers, max: %d", MAX_SUBSCRIBERS);
+  return (NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void FieldWatcher::unsubscribe(Subscriber *subscriber_)
+{
+  // a sweep that started before the deactivation can still be pushing to the queue, the
+  // sequence and active flag are seq_cst on both sides, so either the sweep sees the
+  // subscriber inactive, or we see the sweep in progress and wait for it to finish
+  subscriber_->_active.store(false, memory_order_seq_cst);
+  uint64_t sequence = _sweepSequence.load(memory_order_seq_cst);
+  if ((sequence & 1) != 0)
+  {
+    while (_sweepSequence.load(memory_order_acquire) == sequence)
+    {
+      sched_yield();
+    }
+  }
+  subscriber_->_claimed.store(false, memory_order_release);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline uint64_t FieldWatcher::getNsec(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec*1000000000ULL + now.tv_nsec);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline unsigned FieldWatcher::sweep(void)
+{
+  // one timestamp per sweep, and only if anything changed
+  uint64_t timestamp = 0;
+  unsigned changes = 0;
+  _sweepSequence.fetch_add(1, memory_order_seq_cst);
+  for (unsigned reg = 0; reg < _registers.size(); reg++)
+  {
+    Register &watched = _registers[reg];
+    uint32_t value = watched.reader(watched.device, watched.register_);
+    for (unsigned i = 0; i < watched.fields.size(); i++)
+    {
+      Field &field = _fields[watched.fields[i]];
+      uint32_t newValue = (value >> field.lowOrderBit) & field.mask;
+      if ((newValue == field.value) || !field.initialized)
+      {
+        field.value = newValue;
+        field.initialized = true;
+        continue;
+      }
+      if (timestamp == 0)
+      {
+        timestamp = getNsec();
+      }
+      Event event = {timestamp, watched.fields[i], field.value, newValue};
+      field.value = newValue;
+      changes++;
+      for (unsigned j = 0; j < MAX_SUBSCRIBERS; j++)
+      {
+        if (_subscribers[j]._active.load(memory_order_seq_cst))
+        {
+          _subscribers[j].push(event);
+        }
+      }
+    }
+  }
+  _sweepSequence.fetch_add(1, memory_order_release);
+  _reads.fetch_add(_registers.size(), memory_order_relaxed);
+  _sweeps.fetch_add(1, memory_order_relaxed);
+  return (changes);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline bool FieldWatcher::start(void)
+{
+  if (_running.exchange(true))
+  {
+    DeviceLog::log(DeviceLog::ERROR, "FIELD WATCHER: already running");
+    return (false);
+  }
+  _thread = thread(&FieldWatcher::run, this);
+  return (true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void FieldWatcher::stop(void)
+{
+  if (_running.exchange(false))
+  {
+    _thread.join();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void FieldWatcher::run(void)
+{
+  // sweep on an absolute schedule so the sweep time does not add to the period
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  while (_running.load(memory_order_relaxed))
+  {
+    sweep();
+    if (_periodUsec == 0)
+    {
+      sched_yield();
+      continue;
+    }
+    next.tv_nsec += (long)_periodUsec*1000;
+    while (next.tv_nsec >= 1000000000L)
+    {
+      next.tv_nsec -= 1000000000L;
+      next.tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+  }
+}
+
+#endif
@@ -3,10 +3,18 @@
 
 #include <sys/mman.h>
 #include <fcntl.h>
-#include <string>
+#include <string_view>
 
 #include "TraceLog.h"
 #include <BitfieldMacros.h>
+#include <BitmapScan.h>
+#include <ByteSwapCopy.h>
+#include <DeviceDescriptor.h>
+#include <DeviceLog.h>
+#include <FieldWait.h>
+#include <RegisterAccess.h>
+#include <SubwordAccess.h>
+#include <TableLoader.h>
 
 using namespace std;
 
@@ -34,11 +42,17 @@ class MemoryMappedDevice8
   public:
 
     // constructor for a RAM based buffer address pointer
-    MemoryMappedDevice8(const char *name_, void *address_, unsigned size_) : _address((uint8_t *)address_), _memFd(0), _size(size_), _name(name_), _isMapped(true) {};
+    MemoryMappedDevice8(const char *name_, void *address_, unsigned size_) : _address((uint8_t *)address_), _physicalAddress(0), _size(size_), _name(name_), _device(""), _isMapped(true), _ownsMapping(false), _mapFailed(false), _writeCombining(false) {};
+
+    // constructor from a (constexpr) device descriptor, nothing is copied, allocated, opened, or mapped
+    // here, if the descriptor has a device path it is mapped on the first access, or by map/mapAll,
+    // otherwise the address is used as-is, see DeviceDescriptor.h
+    MemoryMappedDevice8(const DeviceDescriptor &descriptor_);
 
     // constructor for a mapped HW address via a hardcoded address value, if device == NULL, it will just assume the
     // address passed in is already mapped and will be used as-is, if device != NULL, it will do an mmap to map the
-    // device and set the address accordingly
+    // device on the first access (or map/mapAll), the name and device strings are not copied, they must outlive the
+    // device, e.g. string literals
     MemoryMappedDevice8(const char *name_, unsigned long address_, unsigned size_, const char *device_ = NULL);
 
     ~MemoryMappedDevice8();
@@ -51,6 +65,29 @@ class MemoryMappedDevice8
     void setBitfield(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, uint8_t value_){SET_REGISTER_BITFIELD8(register_, lowOrderBit_, highOrderBit_, value_);};
     uint8_t getBitfield(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_){GET_REGISTER_BITFIELD8(register_, lowOrderBit_, highOrderBit_);};
 
+    // get/set registers and bitfields via access semantics aware descriptors, see RegisterAccess.h
+    template <class Register> void writeRegister(uint8_t value_){RegisterAccess::writeRegister<Register>(*this, value_);};
+    template <class Register> uint8_t readRegister(void){return (RegisterAccess::readRegister<Register>(*this));};
+    template <class Field> void setField(uint8_t value_){RegisterAccess::setField<Field>(*this, value_);};
+    template <class Field> uint8_t getField(void){return (RegisterAccess::getField<Field>(*this));};
+    template <class Field> void clearField(void){RegisterAccess::clearField<Field>(*this);};
+
+    // read a bank of consecutive registers, one read per register
+    void readRegisters(unsigned register_, unsigned count_, uint8_t *values_){REGISTER_RANGE_ERROR_CHECKING(register_, count_); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, READ) BitmapScan::read(getAddress(register_), count_, values_);};
+
+    // scan/acknowledge a bank of consecutive registers as one wide bitmap, see BitmapScan.h,
+    // the forEachSetBit callback is bool callback(unsigned bit), return true if the bit was handled
+    unsigned countSetBits(unsigned register_, unsigned count_){REGISTER_RANGE_ERROR_CHECKING(register_, count_, 0); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, READ) return (BitmapScan::countSetBits(getAddress(register_), count_));};
+    int findFirstSetBit(unsigned register_, unsigned count_){REGISTER_RANGE_ERROR_CHECKING(register_, count_, -1); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, READ) return (BitmapScan::findFirstSetBit(getAddress(register_), count_));};
+    template <class Callback>
+    unsigned forEachSetBit(unsigned register_, unsigned count_, Callback callback_, bool acknowledge_ = false){REGISTER_RANGE_ERROR_CHECKING(register_, count_, 0); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, READ) return (BitmapScan::forEachSetBit(getAddress(register_), count_, callback_, acknowledge_));};
+    void acknowledgeBits(unsigned register_, unsigned count_, const uint8_t *bits_){REGISTER_RANGE_ERROR_CHECKING(register_, count_); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, WRITE) BitmapScan::acknowledgeBits(getAddress(register_), count_, bits_);};
+
+#if defined(__cpp_impl_coroutine)
+    // co_await a bitfield value from a coroutine, true when it matches, false on timeout (0 waits forever), see FieldWait.h
+    FieldWaitAwaiter fieldEquals(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, uint8_t value_, unsigned timeoutUsec_ = 0){return (FieldWaitScheduler::getDefault().fieldEquals(*this, register_, lowOrderBit_, highOrderBit_, value_, timeoutUsec_));};
+#endif
+
     // set an address that is already memory mapped via another method
     void setAddress(void *address_){_address = (uint8_t *)address_;};
 
@@ -59,76 +96,104 @@ class MemoryMappedDevice8
     const char *getDevice(void){return (_device.data());};
     unsigned getSize(void){return (_size);};
 
-    // return if memory has been successfully mapped via mmap
+    // return if memory has been successfully mapped via mmap (or is used as-is), a device with a
+    // device path is not mapped until its first access, use map to map it and check it is usable
     bool isMemoryMapped(void){return (_isMapped);};
 
+    // map the device now rather than on the first access, using memFd if it is already open (>= 0),
+    // returns if the device is mapped, a failed map is not retried, see DeviceMapper::mapAll
+    bool map(int memFd_ = -1);
+
+    // map the device write-combining, e.g. a table region, must be set before the device is mapped,
+    // the device path must be a PCI sysfs resourceN_wc file, never for registers with access
+    // semantics, see DeviceDescriptor.h
+    void setWriteCombining(bool enable_){_writeCombining = enable_;};
+    bool isWriteCombining(void){return (_writeCombining);};
+
   protected:
 
     // return the memory mapped address at the specified 8-bit offset
-    volatile uint8_t *getAddress(unsigned offset_ = 0){return (&_address[offset_]);};
+    volatile uint8_t *getAddress(unsigned offset_ = 0){ENSURE_MAPPED() return (&_address[offset_]);};
 
   private:
 
     volatile uint8_t *_address;
-    int _memFd;
+    unsigned long _physicalAddress;
     unsigned _size;
-    string _name;
-    string _device;
+    string_view _name;
+    string_view _device;
     bool _isMapped;
+    bool _ownsMapping;
+    bool _mapFailed;
+    bool _writeCombining;
+    PROFILER_DEVICE_ID
 
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-inline MemoryMappedDevice8::MemoryMappedDevice8(const char *name_, unsigned long address_, unsigned size_, const char *device_)
+inline MemoryMappedDevice8::MemoryMappedDevice8(const char *name_, unsigned long address_, unsigned size_, const char *device_) :
+  _address((device_ == NULL) ? (uint8_t *)address_ : NULL),
+  _physicalAddress(address_),
+  _size(size_),
+  _name(name_),
+  _device((device_ == NULL) ? "" : device_),
+  _isMapped(device_ == NULL),
+  _ownsMapping(false),
+  _mapFailed(false),
+  _writeCombining(false)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline MemoryMappedDevice8::MemoryMappedDevice8(const DeviceDescriptor &descriptor_) :
+  _address(descriptor_.device.empty() ? (uint8_t *)descriptor_.address : NULL),
+  _physicalAddress(descriptor_.address),
+  _size(descriptor_.size),
+  _name(descriptor_.name),
+  _device(descriptor_.device),
+  _isMapped(descriptor_.device.empty()),
+  _ownsMapping(false),
+  _mapFailed(false),
+  _writeCombining(descriptor_.writeCombining)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline bool MemoryMappedDevice8::map(int memFd_)
 {
-  _memFd = 0;
-  _size = size_;
-  _name = name_;
-  _device = device_;
-  if (device_ != NULL)
+  // the first access can come from several threads at once, only the first one maps the device,
+  // the others wait for it, and the address is published last, see ENSURE_MAPPED
+  if (__atomic_load_n(&_address, __ATOMIC_ACQUIRE) != NULL)
+  {
+    return (true);
+  }
+  // a failed map is not retried, so after one the accesses never take the lock
+  if (__atomic_load_n(&_mapFailed, __ATOMIC_ACQUIRE))
   {
-    // setup our base memory mapped address
-    _memFd = open(device_, O_RDWR | O_SYNC);
-    _address = (uint8_t *) mmap(NULL,
-                                size_*sizeof(uint8_t),
-                                PROT_READ | PROT_WRITE,
-                                MAP_SHARED,
-                                _memFd,
-                                address_);
-
-    if (_address == MAP_FAILED)
-    {
-      printf("ERROR: %s failed to map address: 0x%x, size: %d, on device: %s\n", getName(), (uint32_t)address_, size_, device_);
-      _isMapped = false;
-    }
-    else
-    {
-      printf("INFO: %s successfully mapped address: 0x%x, size: %d, on device: %s\n", getName(), (uint32_t)address_, size_, device_);
-      _isMapped = true;
-    }
+    return (false);
   }
-  else
+  lock_guard<mutex> lock(DeviceMapper::getMutex());
+  if (_isMapped || _mapFailed || _device.empty())
   {
-    _address = (uint8_t *)address_;
-    _isMapped = true;
+    return (_isMapped);
   }
+  uint8_t *address = (uint8_t *)DeviceMapper::map(getName(), getDevice(), _physicalAddress, _size*sizeof(uint8_t), memFd_, _writeCombining);
+  _isMapped = _ownsMapping = (address != NULL);
+  __atomic_store_n(&_mapFailed, !_isMapped, __ATOMIC_RELEASE);
+  __atomic_store_n(&_address, address, __ATOMIC_RELEASE);
+  return (_isMapped);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 inline MemoryMappedDevice8::~MemoryMappedDevice8()
 {
-  if ((_memFd != 0) && (_address != MAP_FAILED))
+  if (_ownsMapping)
   {
-    if (munmap((void *)_address, _size) == 0)
-    {
-      printf("INFO: %s successfully unmapped memory on device: %s\n", getName(), getDevice());
-    }
-    else
-    {
-      printf("ERROR: %s failed to unmap memory on device: %s\n", getName(), getDevice());
-    }
+    DeviceMapper::unmap(getName(), getDevice(), (void *)_address, _size*sizeof(uint8_t));
   }
 }
 
@@ -142,11 +207,17 @@ class MemoryMappedDevice16
   public:
 
     // constructor for a RAM based buffer address pointer
-    MemoryMappedDevice16(const char *name_, void *address_, unsigned size_) : _address((uint16_t *)address_), _memFd(0), _size(size_), _name(name_), _isMapped(true) {};
+    MemoryMappedDevice16(const char *name_, void *address_, unsigned size_) : _address((uint16_t *)address_), _physicalAddress(0), _size(size_), _name(name_), _device(""), _isMapped(true), _ownsMapping(false), _mapFailed(false), _writeCombining(false), _subwordAccess(false), _isRam(true) {};
+
+    // constructor from a (constexpr) device descriptor, nothing is copied, allocated, opened, or mapped
+    // here, if the descriptor has a device path it is mapped on the first access, or by map/mapAll,
+    // otherwise the address is used as-is, see DeviceDescriptor.h
+    MemoryMappedDevice16(const DeviceDescriptor &descriptor_);
 
     // constructor for a mapped HW address via a hardcoded address value, if device == NULL, it will just assume the
     // address passed in is already mapped and will be used as-is, if device != NULL, it will do an mmap to map the
-    // device and set the address accordingly
+    // device on the first access (or map/mapAll), the name and device strings are not copied, they must outlive the
+    // device, e.g. string literals
     MemoryMappedDevice16(const char *name_, unsigned long address_, unsigned size_, const char *device_ = NULL);
 
     ~MemoryMappedDevice16();
@@ -159,6 +230,39 @@ class MemoryMappedDevice16
     void setBitfield(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, uint16_t value_){SET_REGISTER_BITFIELD16(register_, lowOrderBit_, highOrderBit_, value_);};
     uint16_t getBitfield(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_){GET_REGISTER_BITFIELD16(register_, lowOrderBit_, highOrderBit_);};
 
+    // get/set registers and bitfields via access semantics aware descriptors, see RegisterAccess.h
+    template <class Register> void writeRegister(uint16_t value_){RegisterAccess::writeRegister<Register>(*this, value_);};
+    template <class Register> uint16_t readRegister(void){return (RegisterAccess::readRegister<Register>(*this));};
+    template <class Field> void setField(uint16_t value_){RegisterAccess::setField<Field>(*this, value_);};
+    template <class Field> uint16_t getField(void){return (RegisterAccess::getField<Field>(*this));};
+    template <class Field> void clearField(void){RegisterAccess::clearField<Field>(*this);};
+
+    // read a bank of consecutive registers, one read per register
+    void readRegisters(unsigned register_, unsigned count_, uint16_t *values_){REGISTER_RANGE_ERROR_CHECKING(register_, count_); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, READ) BitmapScan::read(getAddress(register_), count_, values_);};
+
+    // read/write a block of consecutive registers as endian adjusted values (e.g. descriptor rings and tables),
+    // with the byte swap done a block at a time, and one access per register for HW, see ByteSwapCopy.h
+    void readBlock(unsigned register_, unsigned count_, uint16_t *values_){REGISTER_RANGE_ERROR_CHECKING(register_, count_); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, READ) ByteSwapCopy::fromDevice(values_, getAddress(register_), count_, getTarget());};
+    void writeBlock(unsigned register_, unsigned count_, const uint16_t *values_){REGISTER_RANGE_ERROR_CHECKING(register_, count_); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, WRITE) ByteSwapCopy::toDevice(getAddress(register_), values_, count_, getTarget());};
+
+    // load a (large) table of endian adjusted values into consecutive registers with full cache line non-temporal
+    // stores and a single fence, or stage it a value at a time with a loader (finished when it goes away), see TableLoader.h
+    void loadTable(unsigned register_, unsigned count_, const uint16_t *values_){REGISTER_RANGE_ERROR_CHECKING(register_, count_); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, WRITE) TableLoader<uint16_t> loader(getAddress(register_), count_); loader.append(values_, count_); loader.finish();};
+    TableLoader<uint16_t> getTableLoader(unsigned register_, unsigned count_){REGISTER_RANGE_ERROR_CHECKING(register_, count_, TableLoader<uint16_t>(NULL, 0)); return (TableLoader<uint16_t>(getAddress(register_), count_));};
+
+    // scan/acknowledge a bank of consecutive registers as one wide bitmap, see BitmapScan.h,
+    // the forEachSetBit callback is bool callback(unsigned bit), return true if the bit was handled
+    unsigned countSetBits(unsigned register_, unsigned count_){REGISTER_RANGE_ERROR_CHECKING(register_, count_, 0); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, READ) return (BitmapScan::countSetBits(getAddress(register_), count_));};
+    int findFirstSetBit(unsigned register_, unsigned count_){REGISTER_RANGE_ERROR_CHECKING(register_, count_, -1); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, READ) return (BitmapScan::findFirstSetBit(getAddress(register_), count_));};
+    template <class Callback>
+    unsigned forEachSetBit(unsigned register_, unsigned count_, Callback callback_, bool acknowledge_ = false){REGISTER_RANGE_ERROR_CHECKING(register_, count_, 0); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, READ) return (BitmapScan::forEachSetBit(getAddress(register_), count_, callback_, acknowledge_));};
+    void acknowledgeBits(unsigned register_, unsigned count_, const uint16_t *bits_){REGISTER_RANGE_ERROR_CHECKING(register_, count_); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, WRITE) BitmapScan::acknowledgeBits(getAddress(register_), count_, bits_);};
+
+#if defined(__cpp_impl_coroutine)
+    // co_await a bitfield value from a coroutine, true when it matches, false on timeout (0 waits forever), see FieldWait.h
+    FieldWaitAwaiter fieldEquals(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, uint16_t value_, unsigned timeoutUsec_ = 0){return (FieldWaitScheduler::getDefault().fieldEquals(*this, register_, lowOrderBit_, highOrderBit_, value_, timeoutUsec_));};
+#endif
+
     // set an address that is already memory mapped via another method
     void setAddress(void *address_){_address = (uint16_t *)address_;};
 
@@ -167,76 +271,118 @@ class MemoryMappedDevice16
     const char *getDevice(void){return (_device.data());};
     unsigned getSize(void){return (_size);};
 
-    // return if memory has been successfully mapped via mmap
+    // return if memory has been successfully mapped via mmap (or is used as-is), a device with a
+    // device path is not mapped until its first access, use map to map it and check it is usable
     bool isMemoryMapped(void){return (_isMapped);};
 
+    // map the device now rather than on the first access, using memFd if it is already open (>= 0),
+    // returns if the device is mapped, a failed map is not retried, see DeviceMapper::mapAll
+    bool map(int memFd_ = -1);
+
+    // map the device write-combining, e.g. a table region loaded with loadTable, must be set before
+    // the device is mapped, the device path must be a PCI sysfs resourceN_wc file, never for
+    // registers with access semantics, see DeviceDescriptor.h
+    void setWriteCombining(bool enable_){_writeCombining = enable_;};
+    bool isWriteCombining(void){return (_writeCombining);};
+
+    // enable byte lane sub-word writes of byte and aligned halfword bitfields, only for HW that
+    // supports byte enables, i.e. narrow stores only update those bytes, see SubwordAccess.h
+    void setSubwordAccess(bool enable_){_subwordAccess = enable_;};
+    bool hasSubwordAccess(void){return (_subwordAccess);};
+
   protected:
 
     // return the memory mapped address at the specified 16-bit offset
-    volatile uint16_t *getAddress(unsigned offset_ = 0){return (&_address[offset_]);};
+    volatile uint16_t *getAddress(unsigned offset_ = 0){ENSURE_MAPPED() return (&_address[offset_]);};
+
+    // return the kind of memory for the block copies
+    ByteSwapCopy::Target getTarget(void){return (_isRam ? ByteSwapCopy::RAM : ByteSwapCopy::MMIO);};
 
   private:
 
     volatile uint16_t *_address;
-    int _memFd;
+    unsigned long _physicalAddress;
     unsigned _size;
-    string _name;
-    string _device;
+    string_view _name;
+    string_view _device;
     bool _isMapped;
+    bool _ownsMapping;
+    bool _mapFailed;
+    bool _writeCombining;
+    PROFILER_DEVICE_ID
+    bool _subwordAccess;
+    bool _isRam;
 
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-inline MemoryMappedDevice16::MemoryMappedDevice16(const char *name_, unsigned long address_, unsigned size_, const char *device_)
+inline MemoryMappedDevice16::MemoryMappedDevice16(const char *name_, unsigned long address_, unsigned size_, const char *device_) :
+  _address((device_ == NULL) ? (uint16_t *)address_ : NULL),
+  _physicalAddress(address_),
+  _size(size_),
+  _name(name_),
+  _device((device_ == NULL) ? "" : device_),
+  _isMapped(device_ == NULL),
+  _ownsMapping(false),
+  _mapFailed(false),
+  _writeCombining(false),
+  _subwordAccess(false),
+  _isRam(false)
 {
-  _memFd = 0;
-  _size = size_;
-  _name = name_;
-  _device = device_;
-  if (device_ != NULL)
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline MemoryMappedDevice16::MemoryMappedDevice16(const DeviceDescriptor &descriptor_) :
+  _address(descriptor_.device.empty() ? (uint16_t *)descriptor_.address : NULL),
+  _physicalAddress(descriptor_.address),
+  _size(descriptor_.size),
+  _name(descriptor_.name),
+  _device(descriptor_.device),
+  _isMapped(descriptor_.device.empty()),
+  _ownsMapping(false),
+  _mapFailed(false),
+  _writeCombining(descriptor_.writeCombining),
+  _subwordAccess(false),
+  _isRam(false)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline bool MemoryMappedDevice16::map(int memFd_)
+{
+  // the first access can come from several threads at once, only the first one maps the device,
+  // the others wait for it, and the address is published last, see ENSURE_MAPPED
+  if (__atomic_load_n(&_address, __ATOMIC_ACQUIRE) != NULL)
+  {
+    return (true);
+  }
+  // a failed map is not retried, so after one the accesses never take the lock
+  if (__atomic_load_n(&_mapFailed, __ATOMIC_ACQUIRE))
   {
-    // setup our base memory mapped address
-    _memFd = open(device_, O_RDWR | O_SYNC);
-    _address = (uint16_t *) mmap(NULL,
-                                 size_*sizeof(uint16_t),
-                                 PROT_READ | PROT_WRITE,
-                                 MAP_SHARED,
-                                 _memFd,
-                                 address_);
-
-    if (_address == MAP_FAILED)
-    {
-      printf("ERROR: %s failed to map address: 0x%x, size: %d, on device: %s\n", getName(), (uint32_t)address_, size_, device_);
-      _isMapped = false;
-    }
-    else
-    {
-      printf("INFO: %s successfully mapped address: 0x%x, size: %d, on device: %s\n", getName(), (uint32_t)address_, size_, device_);
-      _isMapped = true;
-    }
+    return (false);
   }
-  else
+  lock_guard<mutex> lock(DeviceMapper::getMutex());
+  if (_isMapped || _mapFailed || _device.empty())
   {
-    _address = (uint16_t *)address_;
-    _isMapped = true;
+    return (_isMapped);
   }
+  uint16_t *address = (uint16_t *)DeviceMapper::map(getName(), getDevice(), _physicalAddress, _size*sizeof(uint16_t), memFd_, _writeCombining);
+  _isMapped = _ownsMapping = (address != NULL);
+  __atomic_store_n(&_mapFailed, !_isMapped, __ATOMIC_RELEASE);
+  __atomic_store_n(&_address, address, __ATOMIC_RELEASE);
+  return (_isMapped);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 inline MemoryMappedDevice16::~MemoryMappedDevice16()
 {
-  if ((_memFd != 0) && (_address != MAP_FAILED))
+  if (_ownsMapping)
   {
-    if (munmap((void *)_address, _size) == 0)
-    {
-      printf("INFO: %s successfully unmapped memory on device: %s\n", getName(), getDevice());
-    }
-    else
-    {
-      printf("ERROR: %s failed to unmap memory on device: %s\n", getName(), getDevice());
-    }
+    DeviceMapper::unmap(getName(), getDevice(), (void *)_address, _size*sizeof(uint16_t));
   }
 }
 
@@ -250,11 +396,17 @@ class MemoryMappedDevice32
   public:
 
     // constructor for a RAM based buffer address pointer
-    MemoryMappedDevice32(const char *name_, void *address_, unsigned size_) : _address((uint32_t *)address_), _memFd(0), _size(size_), _name(name_), _isMapped(true) {};
+    MemoryMappedDevice32(const char *name_, void *address_, unsigned size_) : _address((uint32_t *)address_), _physicalAddress(0), _size(size_), _name(name_), _device(""), _isMapped(true), _ownsMapping(false), _mapFailed(false), _writeCombining(false), _subwordAccess(false), _isRam(true) {};
+
+    // constructor from a (constexpr) device descriptor, nothing is copied, allocated, opened, or mapped
+    // here, if the descriptor has a device path it is mapped on the first access, or by map/mapAll,
+    // otherwise the address is used as-is, see DeviceDescriptor.h
+    MemoryMappedDevice32(const DeviceDescriptor &descriptor_);
 
     // constructor for a mapped HW address via a hardcoded address value, if device == NULL, it will just assume the
     // address passed in is already mapped and will be used as-is, if device != NULL, it will do an mmap to map the
-    // device and set the address accordingly
+    // device on the first access (or map/mapAll), the name and device strings are not copied, they must outlive the
+    // device, e.g. string literals
     MemoryMappedDevice32(const char *name_, unsigned long address_, unsigned size_, const char *device_ = NULL);
 
     ~MemoryMappedDevice32();
@@ -267,6 +419,39 @@ class MemoryMappedDevice32
     void setBitfield(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, uint32_t value_){SET_REGISTER_BITFIELD32(register_, lowOrderBit_, highOrderBit_, value_);};
     uint32_t getBitfield(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_){GET_REGISTER_BITFIELD32(register_, lowOrderBit_, highOrderBit_);};
 
+    // get/set registers and bitfields via access semantics aware descriptors, see RegisterAccess.h
+    template <class Register> void writeRegister(uint32_t value_){RegisterAccess::writeRegister<Register>(*this, value_);};
+    template <class Register> uint32_t readRegister(void){return (RegisterAccess::readRegister<Register>(*this));};
+    template <class Field> void setField(uint32_t value_){RegisterAccess::setField<Field>(*this, value_);};
+    template <class Field> uint32_t getField(void){return (RegisterAccess::getField<Field>(*this));};
+    template <class Field> void clearField(void){RegisterAccess::clearField<Field>(*this);};
+
+    // read a bank of consecutive registers, one read per register
+    void readRegisters(unsigned register_, unsigned count_, uint32_t *values_){REGISTER_RANGE_ERROR_CHECKING(register_, count_); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, READ) BitmapScan::read(getAddress(register_), count_, values_);};
+
+    // read/write a block of consecutive registers as endian adjusted values (e.g. descriptor rings and tables),
+    // with the byte swap done a block at a time, and one access per register for HW, see ByteSwapCopy.h
+    void readBlock(unsigned register_, unsigned count_, uint32_t *values_){REGISTER_RANGE_ERROR_CHECKING(register_, count_); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, READ) ByteSwapCopy::fromDevice(values_, getAddress(register_), count_, getTarget());};
+    void writeBlock(unsigned register_, unsigned count_, const uint32_t *values_){REGISTER_RANGE_ERROR_CHECKING(register_, count_); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, WRITE) ByteSwapCopy::toDevice(getAddress(register_), values_, count_, getTarget());};
+
+    // load a (large) table of endian adjusted values into consecutive registers with full cache line non-temporal
+    // stores and a single fence, or stage it a value at a time with a loader (finished when it goes away), see TableLoader.h
+    void loadTable(unsigned register_, unsigned count_, const uint32_t *values_){REGISTER_RANGE_ERROR_CHECKING(register_, count_); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, WRITE) TableLoader<uint32_t> loader(getAddress(register_), count_); loader.append(values_, count_); loader.finish();};
+    TableLoader<uint32_t> getTableLoader(unsigned register_, unsigned count_){REGISTER_RANGE_ERROR_CHECKING(register_, count_, TableLoader<uint32_t>(NULL, 0)); return (TableLoader<uint32_t>(getAddress(register_), count_));};
+
+    // scan/acknowledge a bank of consecutive registers as one wide bitmap, see BitmapScan.h,
+    // the forEachSetBit callback is bool callback(unsigned bit), return true if the bit was handled
+    unsigned countSetBits(unsigned register_, unsigned count_){REGISTER_RANGE_ERROR_CHECKING(register_, count_, 0); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, READ) return (BitmapScan::countSetBits(getAddress(register_), count_));};
+    int findFirstSetBit(unsigned register_, unsigned count_){REGISTER_RANGE_ERROR_CHECKING(register_, count_, -1); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, READ) return (BitmapScan::findFirstSetBit(getAddress(register_), count_));};
+    template <class Callback>
+    unsigned forEachSetBit(unsigned register_, unsigned count_, Callback callback_, bool acknowledge_ = false){REGISTER_RANGE_ERROR_CHECKING(register_, count_, 0); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, READ) return (BitmapScan::forEachSetBit(getAddress(register_), count_, callback_, acknowledge_));};
+    void acknowledgeBits(unsigned register_, unsigned count_, const uint32_t *bits_){REGISTER_RANGE_ERROR_CHECKING(register_, count_); PROFILE_REGISTER_RANGE_ACCESS(register_, count_, WRITE) BitmapScan::acknowledgeBits(getAddress(register_), count_, bits_);};
+
+#if defined(__cpp_impl_coroutine)
+    // co_await a bitfield value from a coroutine, true when it matches, false on timeout (0 waits forever), see FieldWait.h
+    FieldWaitAwaiter fieldEquals(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, uint32_t value_, unsigned timeoutUsec_ = 0){return (FieldWaitScheduler::getDefault().fieldEquals(*this, register_, lowOrderBit_, highOrderBit_, value_, timeoutUsec_));};
+#endif
+
     // set an address that is already memory mapped via another method
     void setAddress(void *address_){_address = (uint32_t *)address_;};
 
@@ -275,76 +460,118 @@ class MemoryMappedDevice32
     const char *getDevice(void){return (_device.data());};
     unsigned getSize(void){return (_size);};
 
-    // return if memory has been successfully mapped via mmap
+    // return if memory has been successfully mapped via mmap (or is used as-is), a device with a
+    // device path is not mapped until its first access, use map to map it and check it is usable
     bool isMemoryMapped(void){return (_isMapped);};
 
+    // map the device now rather than on the first access, using memFd if it is already open (>= 0),
+    // returns if the device is mapped, a failed map is not retried, see DeviceMapper::mapAll
+    bool map(int memFd_ = -1);
+
+    // map the device write-combining, e.g. a table region loaded with loadTable, must be set before
+    // the device is mapped, the device path must be a PCI sysfs resourceN_wc file, never for
+    // registers with access semantics, see DeviceDescriptor.h
+    void setWriteCombining(bool enable_){_writeCombining = enable_;};
+    bool isWriteCombining(void){return (_writeCombining);};
+
+    // enable byte lane sub-word writes of byte and aligned halfword bitfields, only for HW that
+    // supports byte enables, i.e. narrow stores only update those bytes, see SubwordAccess.h
+    void setSubwordAccess(bool enable_){_subwordAccess = enable_;};
+    bool hasSubwordAccess(void){return (_subwordAccess);};
+
   protected:
 
     // return the memory mapped address at the specified 32-bit offset
-    volatile uint32_t *getAddress(unsigned offset_ = 0){return (&_address[offset_]);};
+    volatile uint32_t *getAddress(unsigned offset_ = 0){ENSURE_MAPPED() return (&_address[offset_]);};
+
+    // return the kind of memory for the block copies
+    ByteSwapCopy::Target getTarget(void){return (_isRam ? ByteSwapCopy::RAM : ByteSwapCopy::MMIO);};
 
   private:
 
     volatile uint32_t *_address;
-    int _memFd;
+    unsigned long _physicalAddress;
     unsigned _size;
-    string _name;
-    string _device;
+    string_view _name;
+    string_view _device;
     bool _isMapped;
+    bool _ownsMapping;
+    bool _mapFailed;
+    bool _writeCombining;
+    PROFILER_DEVICE_ID
+    bool _subwordAccess;
+    bool _isRam;
 
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-inline MemoryMappedDevice32::MemoryMappedDevice32(const char *name_, unsigned long address_, unsigned size_, const char *device_)
+inline MemoryMappedDevice32::MemoryMappedDevice32(const char *name_, unsigned long address_, unsigned size_, const char *device_) :
+  _address((device_ == NULL) ? (uint32_t *)address_ : NULL),
+  _physicalAddress(address_),
+  _size(size_),
+  _name(name_),
+  _device((device_ == NULL) ? "" : device_),
+  _isMapped(device_ == NULL),
+  _ownsMapping(false),
+  _mapFailed(false),
+  _writeCombining(false),
+  _subwordAccess(false),
+  _isRam(false)
 {
-  _memFd = 0;
-  _size = size_;
-  _name = name_;
-  _device = device_;
-  if (device_ != NULL)
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline MemoryMappedDevice32::MemoryMappedDevice32(const DeviceDescriptor &descriptor_) :
+  _address(descriptor_.device.empty() ? (uint32_t *)descriptor_.address : NULL),
+  _physicalAddress(descriptor_.address),
+  _size(descriptor_.size),
+  _name(descriptor_.name),
+  _device(descriptor_.device),
+  _isMapped(descriptor_.device.empty()),
+  _ownsMapping(false),
+  _mapFailed(false),
+  _writeCombining(descriptor_.writeCombining),
+  _subwordAccess(false),
+  _isRam(false)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline bool MemoryMappedDevice32::map(int memFd_)
+{
+  // the first access can come from several threads at once, only the first one maps the device,
+  // the others wait for it, and the address is published last, see ENSURE_MAPPED
+  if (__atomic_load_n(&_address, __ATOMIC_ACQUIRE) != NULL)
+  {
+    return (true);
+  }
+  // a failed map is not retried, so after one the accesses never take the lock
+  if (__atomic_load_n(&_mapFailed, __ATOMIC_ACQUIRE))
   {
-    // setup our base memory mapped address
-    _memFd = open(device_, O_RDWR | O_SYNC);
-    _address = (uint32_t *) mmap(NULL,
-                                 size_*sizeof(uint32_t),
-                                 PROT_READ | PROT_WRITE,
-                                 MAP_SHARED,
-                                 _memFd,
-                                 address_);
-
-    if (_address == MAP_FAILED)
-    {
-      printf("ERROR: %s failed to map address: 0x%x, size: %d, on device: %s\n", getName(), (uint32_t)address_, size_, device_);
-      _isMapped = false;
-    }
-    else
-    {
-      printf("INFO: %s successfully mapped address: 0x%x, size: %d, on device: %s\n", getName(), (uint32_t)address_, size_, device_);
-      _isMapped = true;
-    }
+    return (false);
   }
-  else
+  lock_guard<mutex> lock(DeviceMapper::getMutex());
+  if (_isMapped || _mapFailed || _device.empty())
   {
-    _address = (uint32_t *)address_;
-    _isMapped = true;
+    return (_isMapped);
   }
+  uint32_t *address = (uint32_t *)DeviceMapper::map(getName(), getDevice(), _physicalAddress, _size*sizeof(uint32_t), memFd_, _writeCombining);
+  _isMapped = _ownsMapping = (address != NULL);
+  __atomic_store_n(&_mapFailed, !_isMapped, __ATOMIC_RELEASE);
+  __atomic_store_n(&_address, address, __ATOMIC_RELEASE);
+  return (_isMapped);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 inline MemoryMappedDevice32::~MemoryMappedDevice32()
 {
-  if ((_memFd != 0) && (_address != MAP_FAILED))
+  if (_ownsMapping)
   {
-    if (munmap((void *)_address, _size) == 0)
-    {
-      printf("INFO: %s successfully unmapped memory on device: %s\n", getName(), getDevice());
-    }
-    else
-    {
-      printf("ERROR: %s failed to unmap memory on device: %s\n", getName(), getDevice());
-    }
+    DeviceMapper::unmap(getName(), getDevice(), (void *)_address, _size*sizeof(uint32_t));
   }
 }
 
@@ -60,4 +60,23 @@ class My32BitDevice : public MemoryMappedDevice32
 #define MY_32BIT_REG6  6
 #define MY_32BIT_REG7  7
 
+// access semantics aware descriptors, see RegisterAccess.h, these let the base
+// class pick the right access primitive, e.g. a single write with no read to
+// acknowledge bits of a write-1-to-clear status register, or a compile error
+// for a write to a read-only register, use them with the setField/getField/
+// clearField and writeRegister/readRegister member functions
+
+// REG0 is a plain read/write config register
+typedef RegisterSpec<MY_32BIT_REG0> My32BitReg0;
+typedef FieldSpec<My32BitReg0, MY_32BIT_REG0_BITFIELD1> My32BitReg0Bitfield1;
+typedef FieldSpec<My32BitReg0, MY_32BIT_REG0_BITFIELD2> My32BitReg0Bitfield2;
+typedef FieldSpec<My32BitReg0, MY_32BIT_REG0_BITFIELD3> My32BitReg0Bitfield3;
+typedef FieldSpec<My32BitReg0, MY_32BIT_REG0_BITFIELD4> My32BitReg0Bitfield4;
+
+// REG1 is a write-1-to-clear interrupt status register, REG2 is a read-only
+// version register, REG3 is a write-only command register
+typedef RegisterSpec<MY_32BIT_REG1, AccessType::WRITE_1_TO_CLEAR> My32BitReg1;
+typedef RegisterSpec<MY_32BIT_REG2, AccessType::READ_ONLY> My32BitReg2;
+typedef RegisterSpec<MY_32BIT_REG3, AccessType::WRITE_ONLY> My32BitReg3;
+
 #endif
@@ -0,0 +1,200 @@
+#ifndef REGISTER_ACCESS_H
+#define REGISTER_ACCESS_H
+
+#include <stdint.h>
+
+#include <BitfieldMacros.h>
+#include <BitmapScan.h>
+#include <SubwordAccess.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// This module has access semantics aware register and bitfield descriptors,
+// and the access functions that use them to pick the right access primitive.
+// The generic setBitfield always does a read-modify-write of the whole
+// register, which is wrong (and wastes a read) for registers that are not
+// plain read/write, e.g. it reads garbage from a write-only register, and it
+// writes back every pending bit of a write-1-to-clear status register, i.e.
+// clears interrupts that were never handled.
+//
+// Registers are described by their offset, access type, and for mixed
+// registers, the mask of (endian adjusted) bits that must never be written
+// back as read, i.e. their write-1-to-clear, self-clearing, and write-only
+// bits.  Fields are described by their register and bit range, and inherit
+// the register access type unless given their own, e.g.
+//
+// typedef RegisterSpec<MY_32BIT_REG1, AccessType::WRITE_1_TO_CLEAR> MyIntStatus;
+// typedef FieldSpec<MyIntStatus, 0, 3> MyIntStatusQueues;
+// my32BitDevice.setField<MyIntStatusQueues>(0x5);   // single write, clears just queue 0 and 2
+//
+// The access rules are:
+//
+// READ_WRITE        read-modify-write, the register's clear mask bits are written as 0
+// READ_ONLY         reads only, any write is refused at compile time
+// WRITE_ONLY        writes only, a field write is a plain write with all other bits 0,
+//                   any read is refused at compile time
+// WRITE_1_TO_CLEAR  a field write is a plain write of just the field bits if the whole
+//                   register is write-1-to-clear, otherwise a read-modify-write with the
+//                   register's clear mask bits written as 0
+// READ_TO_CLEAR     reads only, reading clears the bits, any write is refused at compile time
+// SELF_CLEARING     read-modify-write like READ_WRITE, the bits (e.g. a reset or go bit)
+//                   clear themselves, so they belong in the register's clear mask
+//
+// A write-1-to-clear, self-clearing, or write-only field of a register that
+// is written with a read-modify-write (a READ_WRITE or SELF_CLEARING register)
+// must have all its bits in the register's clear mask, otherwise a write to
+// any other field of the register would write its bits back as read, this is
+// checked at compile time when the field is used, e.g.
+//
+// typedef RegisterSpec<MY_32BIT_REG4, AccessType::READ_WRITE, 0x100> MyControl;
+// typedef FieldSpec<MyControl, 0, 7> MyControlMode;
+// typedef FieldSpec<MyControl, 8, 8, AccessType::SELF_CLEARING> MyControlReset;
+//
+////////////////////////////////////////////////////////////////////////////////
+
+enum class AccessType
+{
+  READ_WRITE,
+  READ_ONLY,
+  WRITE_ONLY,
+  WRITE_1_TO_CLEAR,
+  READ_TO_CLEAR,
+  SELF_CLEARING
+};
+
+// register descriptor, offset, access type, and the mask of endian adjusted bits that must
+// be written as 0 on a read-modify-write of the register (W1C, self-clearing, and WO bits)
+template <unsigned Offset, AccessType Access = AccessType::READ_WRITE, uint32_t ClearMask = 0>
+struct RegisterSpec
+{
+  static constexpr unsigned offset = Offset;
+  static constexpr AccessType access = Access;
+  static constexpr uint32_t clearMask = ClearMask;
+};
+
+// bitfield descriptor, parent register, bit range, and access type (defaults to the register's)
+template <class Register, unsigned LowOrderBit, unsigned HighOrderBit, AccessType Access = Register::access>
+struct FieldSpec
+{
+  typedef Register Parent;
+  static constexpr unsigned lowOrderBit = LowOrderBit;
+  static constexpr unsigned highOrderBit = HighOrderBit;
+  static constexpr AccessType access = Access;
+  static constexpr uint32_t mask = (uint32_t)((((uint64_t)1 << (HighOrderBit - LowOrderBit + 1)) - 1) << LowOrderBit);
+
+  static_assert(LowOrderBit <= HighOrderBit, "bitfield lowOrderBit is greater than highOrderBit");
+  static_assert(((Access != AccessType::WRITE_1_TO_CLEAR) && (Access != AccessType::SELF_CLEARING) && (Access != AccessType::WRITE_ONLY)) ||
+                ((Register::access != AccessType::READ_WRITE) && (Register::access != AccessType::SELF_CLEARING)) ||
+                ((Register::clearMask & mask) == mask),
+                "write-1-to-clear, self-clearing, and write-only bitfield bits must be in the register clearMask");
+};
+
+class RegisterAccess
+{
+  public:
+
+    // write a whole register
+    template <class Register, class Device, typename Value>
+    static void writeRegister(Device &device_, Value value_);
+
+    // read a whole register
+    template <class Register, class Device>
+    static auto readRegister(Device &device_) -> decltype(device_.getRegister(0));
+
+    // set a bitfield, using the primitive that matches the field's access type
+    template <class Field, class Device, typename Value>
+    static void setField(Device &device_, Value value_);
+
+    // get a bitfield
+    template <class Field, class Device>
+    static auto getField(Device &device_) -> decltype(device_.getRegister(0));
+
+    // acknowledge (write-1-to-clear) all the bits of a W1C bitfield
+    template <class Field, class Device>
+    static void clearField(Device &device_);
+
+  private:
+
+    static constexpr bool isWritable(AccessType access_){return ((access_ != AccessType::READ_ONLY) && (access_ != AccessType::READ_TO_CLEAR));};
+    static constexpr bool isReadable(AccessType access_){return (access_ != AccessType::WRITE_ONLY);};
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <class Register, class Device, typename Value>
+inline void RegisterAccess::writeRegister(Device &device_, Value value_)
+{
+  static_assert(isWritable(Register::access), "register is not writable");
+  device_.setRegister(Register::offset, value_);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <class Register, class Device>
+inline auto RegisterAccess::readRegister(Device &device_) -> decltype(device_.getRegister(0))
+{
+  static_assert(isReadable(Register::access), "register is not readable");
+  return (device_.getRegister(Register::offset));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <class Field, class Device, typename Value>
+inline void RegisterAccess::setField(Device &device_, Value value_)
+{
+  typedef decltype(device_.getRegister(0)) RegisterValue;
+  typedef typename Field::Parent Register;
+  const unsigned numBits = sizeof(RegisterValue)*8;
+
+  static_assert(Field::highOrderBit < numBits, "bitfield highOrderBit exceeds the register width");
+  static_assert(isWritable(Field::access) && isWritable(Register::access), "bitfield is not writable");
+  SET_BITFIELD_ERROR_CHECKING(Field::lowOrderBit, Field::highOrderBit, numBits, (unsigned)value_)
+
+  RegisterValue bits = (RegisterValue)(((RegisterValue)value_ << Field::lowOrderBit) & Field::mask);
+  if ((Register::access == AccessType::WRITE_ONLY) || (Register::access == AccessType::WRITE_1_TO_CLEAR))
+  {
+    // nothing to preserve (or nothing that can be read), a single write of just the field
+    device_.setRegister(Register::offset, BitmapScan::toRaw(bits));
+    return;
+  }
+  if constexpr (sizeof(RegisterValue) > 1)
+  {
+    if (device_.hasSubwordAccess() && (SubwordAccess::getLaneOffset<RegisterValue>(Field::lowOrderBit, Field::highOrderBit) >= 0))
+    {
+      // a byte lane store does not touch any other bits, so there is nothing to read or mask
+      device_.setBitfield(Register::offset, Field::lowOrderBit, Field::highOrderBit, (RegisterValue)value_);
+      return;
+    }
+  }
+
+  // read-modify-write, never write back the W1C/self-clearing bits as they were read,
+  // and never write back the garbage read from write-only bits
+  RegisterValue value = BitmapScan::toLogical(device_.getRegister(Register::offset));
+  value = (RegisterValue)((value & ~(Field::mask | Register::clearMask)) | bits);
+  device_.setRegister(Register::offset, BitmapScan::toRaw(value));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <class Field, class Device>
+inline auto RegisterAccess::getField(Device &device_) -> decltype(device_.getRegister(0))
+{
+  typedef decltype(device_.getRegister(0)) RegisterValue;
+  typedef typename Field::Parent Register;
+
+  static_assert(Field::highOrderBit < sizeof(RegisterValue)*8, "bitfield highOrderBit exceeds the register width");
+  static_assert(isReadable(Field::access) && isReadable(Register::access), "bitfield is not readable");
+  return ((RegisterValue)((BitmapScan::toLogical(device_.getRegister(Register::offset)) & Field::mask) >> Field::lowOrderBit));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <class Field, class Device>
+inline void RegisterAccess::clearField(Device &device_)
+{
+  static_assert(Field::access == AccessType::WRITE_1_TO_CLEAR, "bitfield is not write-1-to-clear");
+  setField<Field>(device_, Field::mask >> Field::lowOrderBit);
+}
+
+#endif
@@ -0,0 +1,710 @@
+#ifndef REGISTER_BROKER_H
+#define REGISTER_BROKER_H
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <signal.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BROKER_CPU_RELAX() _mm_pause()
+#else
+#define BROKER_CPU_RELAX()
+#endif
+
+#include <BitBanger.h>
+#include <DeviceLog.h>
+#include <MemoryMappedDevice.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// This module has a shared memory register access broker for sharing a single
+// 32-bit memory mapped device between several processes.  One owner process
+// creates a RegisterBrokerServer for its MemoryMappedDevice32, which creates
+// a named POSIX shared memory region with one lock-free request ring per
+// client, any number of other processes (up to MAX_CLIENTS at a time) then
+// create a RegisterBrokerClient with the same name and submit batches of
+// register/bitfield requests through their ring.
+//
+// The server executes all requests on a single thread, so read-modify-write
+// requests from different clients are serialized without any locks or system
+// calls, and plain reads of the same register in the same server sweep are
+// coalesced into a single memory mapped read.  The rings are single producer
+// (the client) single consumer (the server), the server writes the result of
+// each request back into its ring entry and then advances the completion
+// counter that the client spins on.
+//
+// A client gives up on a batch (execute returns false) if the server does not
+// complete it within the client timeout (1 second by default), or as soon as
+// it finds the server gone (its process died, or it was destroyed), so a
+// crashed or restarted server never hangs its clients, a client of a dead
+// server is disconnected, and has to be recreated to attach to a new server.
+// A client that times out on a live server stays connected, its next batch
+// first waits for the server to finish the previous one.  The rings of
+// clients that died without cleaning up are reclaimed by the next clients.
+// A server replaces the region of a server that died without cleaning up,
+// but fails (isReady returns false) if the server of the region is alive.
+//
+// The server never trusts the rings, it executes a private copy of each
+// request, and fails the whole ring of a client whose submitted counter is
+// more than a ring ahead of what it completed.
+//
+// The device can be RAM based for local testing, see benchmark.cc.  On older
+// glibc versions link with -lrt for shm_open.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class RegisterBroker
+{
+  public:
+
+    enum
+    {
+      MAX_CLIENTS = 16,
+      RING_SIZE   = 256   // entries per client ring, must be a power of 2
+    };
+
+    // request operations, register values are raw (as with setRegister/getRegister),
+    // bitfield values are endian adjusted (as with setBitfield/getBitfield)
+    enum Operation
+    {
+      GET_REGISTER,
+      SET_REGISTER,
+      GET_BITFIELD,
+      SET_BITFIELD,
+      MODIFY_REGISTER   // register = (register & ~mask) | (value & mask), atomic w.r.t. all clients
+    };
+
+    // request status
+    enum Status
+    {
+      OK,
+      ERROR
+    };
+
+    // single request, the server fills in the value (for the gets) and the status
+    struct Request
+    {
+      uint32_t operation;
+      uint32_t register_;
+      uint32_t lowOrderBit;
+      uint32_t highOrderBit;
+      uint32_t value;
+      uint32_t mask;
+      uint32_t status;
+      uint32_t reserved;
+    };
+
+  protected:
+
+    enum
+    {
+      MAGIC   = 0x42524b52,   // "BRKR"
+      VERSION = 2
+    };
+
+    // per-client ring, the counters are on their own cache lines so the
+    // client and server never write the same line
+    struct Ring
+    {
+      alignas(64) atomic<uint32_t> owner;        // pid of the client using this ring, 0 if free
+      alignas(64) atomic<uint64_t> submitted;    // written by the client only
+      alignas(64) atomic<uint64_t> completed;    // written by the server only
+      alignas(64) Request entries[RING_SIZE];
+    };
+
+    // layout of the whole shared memory region
+    struct SharedRegion
+    {
+      uint32_t magic;
+      uint32_t version;
+      uint32_t deviceSize;
+      uint32_t serverPid;
+      atomic<uint32_t> ready;
+      Ring rings[MAX_CLIENTS];
+    };
+
+    static_assert(atomic<uint64_t>::is_always_lock_free, "shared memory rings require lock-free 64-bit atomics");
+
+    RegisterBroker(const char *name_) : _region(NULL), _name("/bitBanger.") {_name += name_;};
+
+    // return the POSIX shared memory object name for the broker
+    const char *getShmName(void){return (_name.c_str());};
+
+    // return if the process is gone, a process we may not signal is still there
+    static bool isDead(uint32_t pid_){return ((kill((pid_t)pid_, 0) != 0) && (errno == ESRCH));};
+
+    SharedRegion *_region;
+    string _name;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Server side of the broker, owned by the process that maps the device,
+// someone has to call poll() or run() to service the client requests
+//
+////////////////////////////////////////////////////////////////////////////////
+class RegisterBrokerServer : public RegisterBroker
+{
+  public:
+
+    RegisterBrokerServer(const char *name_, MemoryMappedDevice32 &device_);
+    ~RegisterBrokerServer();
+
+    // return if the shared memory region was successfully created
+    bool isReady(void){return (_region != NULL);};
+
+    // do a single sweep over all the client rings, returns the number of requests executed
+    unsigned poll(void);
+
+    // keep polling until told to stop
+    void run(const atomic<bool> &stop_);
+
+  private:
+
+    // return if the shared memory region exists and belongs to a server that is still running
+    bool isServerAlive(void);
+
+    void execute(Request &request_);
+    bool isValid(const Request &request_);
+
+    MemoryMappedDevice32 &_device;
+    uint64_t _completed[MAX_CLIENTS];
+
+    // read coalescing cache, an entry is valid only if its epoch matches the current sweep
+    vector<uint32_t> _cacheValue;
+    vector<uint64_t> _cacheEpoch;
+    uint64_t _epoch;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Client side of the broker, one per process (or per thread), all
+// requests are synchronous, i.e. execute() returns once the server
+// has completed the whole batch
+//
+////////////////////////////////////////////////////////////////////////////////
+class RegisterBrokerClient : public RegisterBroker
+{
+  public:
+
+    RegisterBrokerClient(const char *name_);
+    ~RegisterBrokerClient();
+
+    // return if we are attached to a server and own a ring
+    bool isConnected(void){return (_ring != NULL);};
+
+    // execute a batch of requests, returns true if all of them completed with OK status,
+    // false if any failed, or the server timed out or is gone
+    bool execute(Request *requests_, unsigned count_);
+
+    // set the time to wait for the server to complete a batch, 0 waits as long as the server is alive
+    void setTimeout(unsigned usec_){_timeoutUsec = usec_;};
+
+    // convenience single request accessors, same semantics as MemoryMappedDevice32
+    void setRegister(unsigned register_, uint32_t value_);
+    uint32_t getRegister(unsigned register_);
+    void setBitfield(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, uint32_t value_);
+    uint32_t getBitfield(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_);
+    void modifyRegister(unsigned register_, uint32_t mask_, uint32_t value_);
+
+    // helpers to fill in a batch entry
+    static Request makeRequest(Operation operation_, unsigned register_, uint32_t value_ = 0, uint32_t mask_ = 0);
+    static Request makeBitfieldRequest(Operation operation_, unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, uint32_t value_ = 0);
+
+  private:
+
+    enum { DEFAULT_TIMEOUT_USEC = 1000000 };
+
+    // wait until the server has completed everything submitted, returns false on timeout,
+    // or if the server is gone, in which case the client is disconnected
+    bool waitForServer(void);
+    void disconnect(void);
+
+    Ring *_ring;
+    uint64_t _submitted;
+    unsigned _timeoutUsec;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline RegisterBrokerServer::RegisterBrokerServer(const char *name_, MemoryMappedDevice32 &device_) :
+  RegisterBroker(name_),
+  _device(device_),
+  _cacheValue(device_.getSize()),
+  _cacheEpoch(device_.getSize(), 0),
+  _epoch(0)
+{
+  memset(_completed, 0, sizeof(_completed));
+
+  // a region left behind by a previous server that died without cleaning up is removed,
+  // but never the region of a live server, then this one fails instead
+  if (isServerAlive())
+  {
+    DeviceLog::log(DeviceLog::ERROR, "%s broker shared memory: %s, is in use by a live server", _device.getName(), getShmName());
+    return;
+  }
+  shm_unlink(getShmName());
+  int fd = shm_open(getShmName(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0)
+  {
+    DeviceLog::log(DeviceLog::ERROR, "%s failed to create broker shared memory: %s", _device.getName(), getShmName());
+    return;
+  }
+  if (ftruncate(fd, sizeof(SharedRegion)) != 0)
+  {
+    DeviceLog::log(DeviceLog::ERROR, "%s failed to size broker shared memory: %s", _device.getName(), getShmName());
+    close(fd);
+    shm_unlink(getShmName());
+    return;
+  }
+  void *region = mmap(NULL, sizeof(SharedRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (region == MAP_FAILED)
+  {
+    DeviceLog::log(DeviceLog::ERROR, "%s failed to map broker shared memory: %s", _device.getName(), getShmName());
+    shm_unlink(getShmName());
+    return;
+  }
+
+  // the region is zero filled by ftruncate, so all the rings start out free and empty
+  _region = (SharedRegion *)region;
+  _region->magic = MAGIC;
+  _region->version = VERSION;
+  _region->deviceSize = _device.getSize();
+  _region->serverPid = (uint32_t)getpid();
+  _region->ready.store(1, memory_order_release);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline bool RegisterBrokerServer::isServerAlive(void)
+{
+  int fd = shm_open(getShmName(), O_RDONLY, 0600);
+  if (fd < 0)
+  {
+    return (false);
+  }
+  // a region too small to have a header, or without a server pid yet, is stale
+  struct stat status;
+  SharedRegion *region = NULL;
+  if ((fstat(fd, &status) == 0) && ((size_t)status.st_size >= sizeof(SharedRegion)))
+  {
+    void *address = mmap(NULL, sizeof(SharedRegion), PROT_READ, MAP_SHARED, fd, 0);
+    region = (address != MAP_FAILED) ? (SharedRegion *)address : NULL;
+  }
+  close(fd);
+  if (region == NULL)
+  {
+    return (false);
+  }
+  bool alive = (region->magic == MAGIC) && (region->serverPid != 0) && !isDead(region->serverPid);
+  munmap(region, sizeof(SharedRegion));
+  return (alive);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline RegisterBrokerServer::~RegisterBrokerServer()
+{
+  if (_region != NULL)
+  {
+    _region->ready.store(0, memory_order_release);
+    munmap(_region, sizeof(SharedRegion));
+    shm_unlink(getShmName());
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline bool RegisterBrokerServer::isValid(const Request &request_)
+{
+  if (request_.register_ >= _device.getSize())
+  {
+    return (false);
+  }
+  if ((request_.operation == GET_BITFIELD) || (request_.operation == SET_BITFIELD))
+  {
+    if ((request_.lowOrderBit > request_.highOrderBit) || (request_.highOrderBit > 31))
+    {
+      return (false);
+    }
+    // 64-bit shift, a full width (0-31) field would shift a 32-bit 1 out of range
+    if ((request_.operation == SET_BITFIELD) && (request_.value > (uint32_t)((1ULL << (request_.highOrderBit - request_.lowOrderBit + 1)) - 1)))
+    {
+      return (false);
+    }
+  }
+  return (request_.operation <= MODIFY_REGISTER);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void RegisterBrokerServer::execute(Request &request_)
+{
+  if (!isValid(request_))
+  {
+    request_.status = ERROR;
+    return;
+  }
+
+  unsigned reg = request_.register_;
+  uint32_t value;
+  switch (request_.operation)
+  {
+    case GET_REGISTER:
+    case GET_BITFIELD:
+      // plain reads are coalesced with any other read of the same register in this sweep
+      if (_cacheEpoch[reg] != _epoch)
+      {
+        _cacheValue[reg] = _device.getRegister(reg);
+        _cacheEpoch[reg] = _epoch;
+      }
+      value = _cacheValue[reg];
+      request_.value = (request_.operation == GET_REGISTER) ? value : BitBanger::getBitfield(value, request_.lowOrderBit, request_.highOrderBit);
+      break;
+    case SET_REGISTER:
+      _device.setRegister(reg, request_.value);
+      _cacheEpoch[reg] = 0;
+      break;
+    case SET_BITFIELD:
+      // always a fresh read for read-modify-write, the HW may have changed other bits
+      _device.setBitfield(reg, request_.lowOrderBit, request_.highOrderBit, request_.value);
+      _cacheEpoch[reg] = 0;
+      break;
+    case MODIFY_REGISTER:
+      value = _device.getRegister(reg);
+      _device.setRegister(reg, (value & ~request_.mask) | (request_.value & request_.mask));
+      _cacheEpoch[reg] = 0;
+      break;
+  }
+  request_.status = OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline unsigned RegisterBrokerServer::poll(void)
+{
+  if (_region == NULL)
+  {
+    return (0);
+  }
+
+  // new sweep, invalidates all the coalesced reads from the previous one
+  _epoch++;
+  unsigned executed = 0;
+  for (unsigned i = 0; i < MAX_CLIENTS; i++)
+  {
+    Ring &ring = _region->rings[i];
+    uint64_t submitted = ring.submitted.load(memory_order_acquire);
+    if (submitted == _completed[i])
+    {
+      continue;
+    }
+    // the counter and the entries are written by the client, a counter more than a ring
+    // ahead of (or behind) what we completed is rejected, the whole ring is failed, and we
+    // resync to it
+    if ((submitted - _completed[i]) > RING_SIZE)
+    {
+      DeviceLog::log(DeviceLog::ERROR, "%s broker client ring: %d, submitted: %llu, completed: %llu, is out of range", _device.getName(), i, (unsigned long long)submitted, (unsigned long long)_completed[i]);
+      for (unsigned j = 0; j < RING_SIZE; j++)
+      {
+        ring.entries[j].status = ERROR;
+      }
+      _completed[i] = submitted;
+      ring.completed.store(submitted, memory_order_release);
+      continue;
+    }
+    for (uint64_t j = _completed[i]; j < submitted; j++)
+    {
+      // validate and execute a private copy, so the client can not change a request in
+      // between, only the results are written back
+      Request &entry = ring.entries[j & (RING_SIZE-1)];
+      Request request = entry;
+      execute(request);
+      entry.value = request.value;
+      entry.status = request.status;
+    }
+    executed += (unsigned)(submitted - _completed[i]);
+    _completed[i] = submitted;
+    ring.completed.store(submitted, memory_order_release);
+  }
+  return (executed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void RegisterBrokerServer::run(const atomic<bool> &stop_)
+{
+  unsigned idle = 0;
+  while (!stop_.load(memory_order_relaxed))
+  {
+    if (poll() != 0)
+    {
+      idle = 0;
+    }
+    else if (++idle < 1024)
+    {
+      BROKER_CPU_RELAX();
+    }
+    else
+    {
+      // nobody is talking to us, let the clients have the CPU
+      sched_yield();
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline RegisterBrokerClient::RegisterBrokerClient(const char *name_) : RegisterBroker(name_), _ring(NULL), _submitted(0), _timeoutUsec(DEFAULT_TIMEOUT_USEC)
+{
+  int fd = shm_open(getShmName(), O_RDWR, 0600);
+  if (fd < 0)
+  {
+    DeviceLog::log(DeviceLog::ERROR, "broker client failed to open shared memory: %s", getShmName());
+    return;
+  }
+  void *region = mmap(NULL, sizeof(SharedRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (region == MAP_FAILED)
+  {
+    DeviceLog::log(DeviceLog::ERROR, "broker client failed to map shared memory: %s", getShmName());
+    return;
+  }
+  _region = (SharedRegion *)region;
+  if ((_region->ready.load(memory_order_acquire) == 0) || (_region->magic != MAGIC) || (_region->version != VERSION) || isDead(_region->serverPid))
+  {
+    DeviceLog::log(DeviceLog::ERROR, "broker client found no server on shared memory: %s", getShmName());
+    munmap(_region, sizeof(SharedRegion));
+    _region = NULL;
+    return;
+  }
+
+  // claim a free ring, or the ring of a client that died without releasing it
+  uint32_t pid = (uint32_t)getpid();
+  for (unsigned i = 0; i < MAX_CLIENTS; i++)
+  {
+    uint32_t owner = 0;
+    if (_region->rings[i].owner.compare_exchange_strong(owner, pid, memory_order_acq_rel) ||
+        (isDead(owner) && _region->rings[i].owner.compare_exchange_strong(owner, pid, memory_order_acq_rel)))
+    {
+      _ring = &_region->rings[i];
+      _submitted = _ring->submitted.load(memory_order_acquire);
+      if (!waitForServer())
+      {
+        // the last batch of the previous owner (dead, or timed out) is still not completed
+        DeviceLog::log(DeviceLog::ERROR, "broker client could not reclaim ring: %d, on shared memory: %s", i, getShmName());
+        disconnect();
+      }
+      return;
+    }
+  }
+  DeviceLog::log(DeviceLog::ERROR, "broker client found no free rings on shared memory: %s, max clients: %d", getShmName(), MAX_CLIENTS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline RegisterBrokerClient::~RegisterBrokerClient()
+{
+  disconnect();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void RegisterBrokerClient::disconnect(void)
+{
+  if (_ring != NULL)
+  {
+    _ring->owner.store(0, memory_order_release);
+    _ring = NULL;
+  }
+  if (_region != NULL)
+  {
+    munmap(_region, sizeof(SharedRegion));
+    _region = NULL;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline bool RegisterBrokerClient::waitForServer(void)
+{
+  // spin for the server, only give up the CPU if it is taking a while, and only
+  // look at the clock and the server every so often once we are yielding
+  uint64_t deadline = 0;
+  unsigned spins = 0;
+  while (_ring->completed.load(memory_order_acquire) < _submitted)
+  {
+    if (++spins < 1024)
+    {
+      BROKER_CPU_RELAX();
+      continue;
+    }
+    sched_yield();
+    if ((spins & 255) != 0)
+    {
+      continue;
+    }
+    if ((_region->ready.load(memory_order_acquire) == 0) || isDead(_region->serverPid))
+    {
+      DeviceLog::log(DeviceLog::ERROR, "broker client lost the server on shared memory: %s", getShmName());
+      disconnect();
+      return (false);
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t nsec = (uint64_t)now.tv_sec*1000000000ULL + now.tv_nsec;
+    if (deadline == 0)
+    {
+      deadline = nsec + (uint64_t)_timeoutUsec*1000;
+    }
+    else if ((_timeoutUsec != 0) && (nsec >= deadline))
+    {
+      DeviceLog::log(DeviceLog::ERROR, "broker client timed out on shared memory: %s, after: %d usec", getShmName(), _timeoutUsec);
+      return (false);
+    }
+  }
+  return (true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline bool RegisterBrokerClient::execute(Request *requests_, unsigned count_)
+{
+  if (_ring == NULL)
+  {
+    DeviceLog::log(DeviceLog::ERROR, "broker client is not connected to shared memory: %s", getShmName());
+    return (false);
+  }
+
+  // a previous batch that timed out has to be completed before the ring can be reused
+  if (!waitForServer())
+  {
+    return (false);
+  }
+
+  bool success = true;
+  while (count_ > 0)
+  {
+    // the previous chunk has completed so the whole ring is free
+    unsigned chunk = (count_ < (unsigned)RING_SIZE) ? count_ : (unsigned)RING_SIZE;
+    for (unsigned i = 0; i < chunk; i++)
+    {
+      _ring->entries[(_submitted+i) & (RING_SIZE-1)] = requests_[i];
+    }
+    _submitted += chunk;
+    _ring->submitted.store(_submitted, memory_order_release);
+
+    if (!waitForServer())
+    {
+      return (false);
+    }
+
+    for (unsigned i = 0; i < chunk; i++)
+    {
+      requests_[i] = _ring->entries[(_submitted-chunk+i) & (RING_SIZE-1)];
+      success = success && (requests_[i].status == OK);
+    }
+    requests_ += chunk;
+    count_ -= chunk;
+  }
+  return (success);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline RegisterBroker::Request RegisterBrokerClient::makeRequest(Operation operation_, unsigned register_, uint32_t value_, uint32_t mask_)
+{
+  Request request = {};
+  request.operation = operation_;
+  request.register_ = register_;
+  request.value = value_;
+  request.mask = mask_;
+  return (request);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline RegisterBroker::Request RegisterBrokerClient::makeBitfieldRequest(Operation operation_, unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, uint32_t value_)
+{
+  Request request = makeRequest(operation_, register_, value_);
+  request.lowOrderBit = lowOrderBit_;
+  request.highOrderBit = highOrderBit_;
+  return (request);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void RegisterBrokerClient::setRegister(unsigned register_, uint32_t value_)
+{
+  Request request = makeRequest(SET_REGISTER, register_, value_);
+  if (!execute(&request, 1))
+  {
+    DeviceLog::log(DeviceLog::ERROR, "broker: %s, failed to set register: %d", getShmName(), register_);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline uint32_t RegisterBrokerClient::getRegister(unsigned register_)
+{
+  Request request = makeRequest(GET_REGISTER, register_);
+  if (!execute(&request, 1))
+  {
+    DeviceLog::log(DeviceLog::ERROR, "broker: %s, failed to get register: %d", getShmName(), register_);
+    return (0);
+  }
+  return (request.value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void RegisterBrokerClient::setBitfield(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, uint32_t value_)
+{
+  Request request = makeBitfieldRequest(SET_BITFIELD, register_, lowOrderBit_, highOrderBit_, value_);
+  if (!execute(&request, 1))
+  {
+    DeviceLog::log(DeviceLog::ERROR, "broker: %s, failed to set register: %d, bitfield: %d-%d, value: %d", getShmName(), register_, lowOrderBit_, highOrderBit_, value_);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline uint32_t RegisterBrokerClient::getBitfield(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_)
+{
+  Request request = makeBitfieldRequest(GET_BITFIELD, register_, lowOrderBit_, highOrderBit_);
+  if (!execute(&request, 1))
+  {
+    DeviceLog::log(DeviceLog::ERROR, "broker: %s, failed to get register: %d, bitfield: %d-%d", getShmName(), register_, lowOrderBit_, highOrderBit_);
+    return (0);
+  }
+  return (request.value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void RegisterBrokerClient::modifyRegister(unsigned register_, uint32_t mask_, uint32_t value_)
+{
+  Request request = makeRequest(MODIFY_REGISTER, register_, value_, mask_);
+  if (!execute(&request, 1))
+  {
+    DeviceLog::log(DeviceLog::ERROR, "broker: %s, failed to modify register: %d", getShmName(), register_);
+  }
+}
+
+#endif
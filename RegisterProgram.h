@@ -0,0 +1,485 @@
+#ifndef REGISTER_PROGRAM_H
+#define REGISTER_PROGRAM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include <BitBanger.h>
+#include <DeviceLog.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// This module has a compact register program format for device init/bring-up
+// sequences and a small interpreter to run them against any of the memory
+// mapped device classes.  A program is a flat array of fixed size (16 byte)
+// instructions, it can be built at compile time into read-only data, e.g.
+//
+// static constexpr RegisterInstruction myInit[] =
+// {
+//   RegisterProgram::write(MY_32BIT_REG1, 0),
+//   RegisterProgram::setField(MY_32BIT_REG0, MY_32BIT_REG0_BITFIELD2, 3),
+//   RegisterProgram::setField(MY_32BIT_REG0, MY_32BIT_REG0_BITFIELD3, 5),
+//   RegisterProgram::poll(MY_32BIT_REG0, MY_32BIT_REG0_BITFIELD1, 1, 1000),
+// };
+// RegisterProgram::run(my32BitDevice, myInit);
+//
+// or loaded from a text file, so init sequences can change without a rebuild,
+// one instruction per line, '#' starts a comment, numbers are decimal or 0x hex:
+//
+// write  <register> <value>
+// field  <register> <lowOrderBit> <highOrderBit> <value>
+// modify <register> <mask> <value>
+// poll   <register> <lowOrderBit> <highOrderBit> <value> <timeoutUsec>
+// delay  <usec>
+// loop   <count>
+// endloop
+// flush
+//
+// Register values (write, modify) are raw as with setRegister, field values
+// are endian adjusted as with setBitfield.  The interpreter keeps the value of
+// the last register touched in a local, consecutive field and modify
+// instructions on the same register are applied to that local and go out as a
+// single write, i.e. one read and one write for a whole run of field updates.
+// A write instruction always pushes out any pending value first so repeated
+// writes (e.g. pulsing a reset bit) all reach the HW, use flush between field
+// instructions when an intermediate value must reach the HW as well.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// single register program instruction
+struct RegisterInstruction
+{
+  uint8_t opcode;
+  uint8_t lowOrderBit;
+  uint8_t highOrderBit;
+  uint8_t reserved;
+  uint32_t register_;
+  uint32_t value;
+  uint32_t argument;   // mask for modify, timeout in usec for poll, count for loop
+};
+
+class RegisterProgram
+{
+  public:
+
+    enum Opcode
+    {
+      WRITE,
+      SET_FIELD,
+      MODIFY,
+      POLL,
+      DELAY,
+      LOOP,
+      END_LOOP,
+      FLUSH
+    };
+
+    enum Status
+    {
+      OK,
+      INVALID,
+      TIMEOUT
+    };
+
+    // max nesting of loops
+    enum { MAX_LOOP_DEPTH = 8 };
+
+    // result of running a program, the instruction index is the failing instruction if not OK
+    struct Result
+    {
+      Status status;
+      unsigned instruction;
+    };
+
+    // instruction builders, all constexpr so programs can be built at compile time
+    static constexpr RegisterInstruction write(unsigned register_, uint32_t value_){return (makeInstruction(WRITE, register_, 0, 0, value_, 0));};
+    static constexpr RegisterInstruction setField(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, uint32_t value_){return (makeInstruction(SET_FIELD, register_, lowOrderBit_, highOrderBit_, value_, 0));};
+    static constexpr RegisterInstruction modify(unsigned register_, uint32_t mask_, uint32_t value_){return (makeInstruction(MODIFY, register_, 0, 0, value_, mask_));};
+    static constexpr RegisterInstruction poll(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, uint32_t value_, uint32_t timeoutUsec_){return (makeInstruction(POLL, register_, lowOrderBit_, highOrderBit_, value_, timeoutUsec_));};
+    static constexpr RegisterInstruction delay(uint32_t usec_){return (makeInstruction(DELAY, 0, 0, 0, usec_, 0));};
+    static constexpr RegisterInstruction loop(uint32_t count_){return (makeInstruction(LOOP, 0, 0, 0, 0, count_));};
+    static constexpr RegisterInstruction endLoop(void){return (makeInstruction(END_LOOP, 0, 0, 0, 0, 0));};
+    static constexpr RegisterInstruction flush(void){return (makeInstruction(FLUSH, 0, 0, 0, 0, 0));};
+
+    // load a program from a text file, returns false (with an error message) on any parse error
+    static bool load(const char *fileName_, vector<RegisterInstruction> &program_);
+
+    // check a program against a device size and width, i.e. register ranges, bitfields, values, and loop nesting
+    static bool validate(const RegisterInstruction *program_, unsigned count_, unsigned size_, unsigned numBits_, unsigned &instruction_);
+
+    // validate and run a program against a device
+    template <class Device>
+    static Result run(Device &device_, const RegisterInstruction *program_, unsigned count_);
+
+    template <class Device>
+    static Result run(Device &device_, const vector<RegisterInstruction> &program_){return (run(device_, program_.data(), program_.size()));};
+
+    template <class Device, unsigned N>
+    static Result run(Device &device_, const RegisterInstruction (&program_)[N]){return (run(device_, program_, N));};
+
+  private:
+
+    // bit numbers that do not fit in the instruction are stored as INVALID_BIT rather than
+    // truncated, so validate rejects them instead of seeing a different (valid) bitfield
+    enum { INVALID_BIT = 0xff };
+    static constexpr uint8_t makeBit(unsigned bit_){return ((bit_ < INVALID_BIT) ? (uint8_t)bit_ : (uint8_t)INVALID_BIT);};
+
+    static constexpr RegisterInstruction makeInstruction(Opcode opcode_, unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, uint32_t value_, uint32_t argument_)
+    {
+      return (RegisterInstruction{(uint8_t)opcode_, makeBit(lowOrderBit_), makeBit(highOrderBit_), 0, register_, value_, argument_});
+    };
+
+    static uint64_t getUsec(void);
+    static void sleepUsec(uint32_t usec_);
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline uint64_t RegisterProgram::getUsec(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec*1000000ULL + now.tv_nsec/1000);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline void RegisterProgram::sleepUsec(uint32_t usec_)
+{
+  struct timespec delay;
+  delay.tv_sec = usec_/1000000;
+  delay.tv_nsec = (usec_%1000000)*1000;
+  while (nanosleep(&delay, &delay) != 0)
+  {
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline bool RegisterProgram::load(const char *fileName_, vector<RegisterInstruction> &program_)
+{
+  FILE *file = fopen(fileName_, "r");
+  if (file == NULL)
+  {
+    DeviceLog::log(DeviceLog::ERROR, "PROGRAM: could not open file: %s", fileName_);
+    return (false);
+  }
+
+  struct Syntax
+  {
+    const char *name;
+    Opcode opcode;
+    unsigned numArgs;
+  };
+  static const Syntax syntax[] =
+  {
+    {"write",   WRITE,     2},
+    {"field",   SET_FIELD, 4},
+    {"modify",  MODIFY,    3},
+    {"poll",    POLL,      5},
+    {"delay",   DELAY,     1},
+    {"loop",    LOOP,      1},
+    {"endloop", END_LOOP,  0},
+    {"flush",   FLUSH,     0},
+  };
+
+  program_.clear();
+  char line[256];
+  unsigned lineNumber = 0;
+  bool success = true;
+  while (success && (fgets(line, sizeof(line), file) != NULL))
+  {
+    lineNumber++;
+    char *comment = strchr(line, '#');
+    if (comment != NULL)
+    {
+      *comment = 0;
+    }
+    char *token = strtok(line, " \t\r\n");
+    if (token == NULL)
+    {
+      continue;
+    }
+
+    const Syntax *instruction = NULL;
+    for (unsigned i = 0; i < sizeof(syntax)/sizeof(syntax[0]); i++)
+    {
+      if (strcmp(token, syntax[i].name) == 0)
+      {
+        instruction = &syntax[i];
+      }
+    }
+    if (instruction == NULL)
+    {
+      DeviceLog::log(DeviceLog::ERROR, "PROGRAM: %s, line: %d, unknown instruction: %s", fileName_, lineNumber, token);
+      success = false;
+      break;
+    }
+
+    uint32_t args[5] = {0};
+    for (unsigned i = 0; i < instruction->numArgs; i++)
+    {
+      char *end = NULL;
+      unsigned long long arg = 0;
+      token = strtok(NULL, " \t\r\n");
+      if (token != NULL)
+      {
+        arg = strtoull(token, &end, 0);
+      }
+      if ((token == NULL) || (*end != 0))
+      {
+        DeviceLog::log(DeviceLog::ERROR, "PROGRAM: %s, line: %d, %s, expected %d numeric arguments", fileName_, lineNumber, instruction->name, instruction->numArgs);
+        success = false;
+        break;
+      }
+      if (arg > 0xffffffffULL)
+      {
+        DeviceLog::log(DeviceLog::ERROR, "PROGRAM: %s, line: %d, %s, argument: %s, exceeds 32 bits", fileName_, lineNumber, instruction->name, token);
+        success = false;
+        break;
+      }
+      args[i] = (uint32_t)arg;
+    }
+    if (success && ((instruction->opcode == SET_FIELD) || (instruction->opcode == POLL)) && ((args[1] > 31) || (args[2] > 31)))
+    {
+      DeviceLog::log(DeviceLog::ERROR, "PROGRAM: %s, line: %d, %s, invalid bitfield: %u-%u", fileName_, lineNumber, instruction->name, args[1], args[2]);
+      success = false;
+    }
+    if (success && (strtok(NULL, " \t\r\n") != NULL))
+    {
+      DeviceLog::log(DeviceLog::ERROR, "PROGRAM: %s, line: %d, %s, too many arguments", fileName_, lineNumber, instruction->name);
+      success = false;
+    }
+    if (!success)
+    {
+      break;
+    }
+
+    switch (instruction->opcode)
+    {
+      case WRITE:     program_.push_back(write(args[0], args[1])); break;
+      case SET_FIELD: program_.push_back(setField(args[0], args[1], args[2], args[3])); break;
+      case MODIFY:    program_.push_back(modify(args[0], args[1], args[2])); break;
+      case POLL:      program_.push_back(poll(args[0], args[1], args[2], args[3], args[4])); break;
+      case DELAY:     program_.push_back(delay(args[0])); break;
+      case LOOP:      program_.push_back(loop(args[0])); break;
+      case END_LOOP:  program_.push_back(endLoop()); break;
+      case FLUSH:     program_.push_back(flush()); break;
+    }
+  }
+  fclose(file);
+  if (!success)
+  {
+    program_.clear();
+  }
+  return (success);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+inline bool RegisterProgram::validate(const RegisterInstruction *program_, unsigned count_, unsigned size_, unsigned numBits_, unsigned &instruction_)
+{
+  unsigned depth = 0;
+  for (instruction_ = 0; instruction_ < count_; instruction_++)
+  {
+    const RegisterInstruction &instruction = program_[instruction_];
+    switch (instruction.opcode)
+    {
+      case WRITE:
+      case SET_FIELD:
+      case MODIFY:
+      case POLL:
+        if (instruction.register_ >= size_)
+        {
+          DeviceLog::log(DeviceLog::ERROR, "PROGRAM: instruction: %d, register: %d, exceeds memory mapped size: %d", instruction_, instruction.register_, size_);
+          return (false);
+        }
+        if ((instruction.opcode == SET_FIELD) || (instruction.opcode == POLL))
+        {
+          if ((instruction.lowOrderBit > instruction.highOrderBit) || (instruction.highOrderBit > (numBits_-1)))
+          {
+            DeviceLog::log(DeviceLog::ERROR, "PROGRAM: instruction: %d, invalid bitfield: %d-%d, for %d-bit value", instruction_, instruction.lowOrderBit, instruction.highOrderBit, numBits_);
+            return (false);
+          }
+          // 64-bit shift, a full width (e.g. 0-31) field would shift a 32-bit 1 out of range
+          uint32_t maxValue = (uint32_t)((1ULL << (instruction.highOrderBit - instruction.lowOrderBit + 1)) - 1);
+          if (instruction.value > maxValue)
+          {
+            DeviceLog::log(DeviceLog::ERROR, "PROGRAM: instruction: %d, value: %u, exceeds max bitfield value: %u", instruction_, instruction.value, maxValue);
+            return (false);
+          }
+        }
+        break;
+      case LOOP:
+        if (++depth > MAX_LOOP_DEPTH)
+        {
+          DeviceLog::log(DeviceLog::ERROR, "PROGRAM: instruction: %d, loops nested deeper than: %d", instruction_, MAX_LOOP_DEPTH);
+          return (false);
+        }
+        break;
+      case END_LOOP:
+        if (depth-- == 0)
+        {
+          DeviceLog::log(DeviceLog::ERROR, "PROGRAM: instruction: %d, endloop without loop", instruction_);
+          return (false);
+        }
+        break;
+      case DELAY:
+      case FLUSH:
+        break;
+      default:
+        DeviceLog::log(DeviceLog::ERROR, "PROGRAM: instruction: %d, invalid opcode: %d", instruction_, instruction.opcode);
+        return (false);
+    }
+  }
+  if (depth != 0)
+  {
+    DeviceLog::log(DeviceLog::ERROR, "PROGRAM: %d loop(s) without endloop", depth);
+    return (false);
+  }
+  return (true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <class Device>
+inline RegisterProgram::Result RegisterProgram::run(Device &device_, const RegisterInstruction *program_, unsigned count_)
+{
+  typedef decltype(device_.getRegister(0)) Value;
+
+  Result result = {OK, 0};
+  if (!validate(program_, count_, device_.getSize(), sizeof(Value)*8, result.instruction))
+  {
+    result.status = INVALID;
+    return (result);
+  }
+  result.instruction = 0;
+
+  // the pending register, i.e. the last register touched and its current value
+  bool pending = false;
+  bool dirty = false;
+  unsigned reg = 0;
+  Value value = 0;
+
+  // loop stack, start instruction and remaining iterations
+  unsigned loopStart[MAX_LOOP_DEPTH];
+  uint32_t loopRemaining[MAX_LOOP_DEPTH];
+  unsigned depth = 0;
+
+  for (unsigned pc = 0; pc < count_; pc++)
+  {
+    const RegisterInstruction &instruction = program_[pc];
+    switch (instruction.opcode)
+    {
+      case WRITE:
+        if (dirty)
+        {
+          device_.setRegister(reg, value);
+        }
+        pending = true;
+        dirty = true;
+        reg = instruction.register_;
+        value = (Value)instruction.value;
+        break;
+      case SET_FIELD:
+      case MODIFY:
+        if (!pending || (reg != instruction.register_))
+        {
+          if (dirty)
+          {
+            device_.setRegister(reg, value);
+          }
+          reg = instruction.register_;
+          value = device_.getRegister(reg);
+          pending = true;
+        }
+        if (instruction.opcode == SET_FIELD)
+        {
+          BitBanger::setBitfield(value, instruction.lowOrderBit, instruction.highOrderBit, (Value)instruction.value);
+        }
+        else
+        {
+          value = (Value)((value & ~instruction.argument) | (instruction.value & instruction.argument));
+        }
+        dirty = true;
+        break;
+      case POLL:
+      {
+        if (dirty)
+        {
+          device_.setRegister(reg, value);
+        }
+        pending = dirty = false;
+        uint64_t deadline = getUsec() + instruction.argument;
+        while (device_.getBitfield(instruction.register_, instruction.lowOrderBit, instruction.highOrderBit) != instruction.value)
+        {
+          if (getUsec() >= deadline)
+          {
+            result.status = TIMEOUT;
+            result.instruction = pc;
+            return (result);
+          }
+        }
+        break;
+      }
+      case DELAY:
+      case FLUSH:
+      case LOOP:
+      case END_LOOP:
+        // everything else is a barrier for the pending register
+        if (dirty)
+        {
+          device_.setRegister(reg, value);
+        }
+        pending = dirty = false;
+        if (instruction.opcode == DELAY)
+        {
+          sleepUsec(instruction.value);
+        }
+        else if (instruction.opcode == LOOP)
+        {
+          if (instruction.argument == 0)
+          {
+            // skip the whole body, find the matching endloop
+            unsigned nesting = 1;
+            while (nesting > 0)
+            {
+              pc++;
+              nesting += (program_[pc].opcode == LOOP) ? 1 : ((program_[pc].opcode == END_LOOP) ? -1 : 0);
+            }
+          }
+          else
+          {
+            loopStart[depth] = pc;
+            loopRemaining[depth] = instruction.argument;
+            depth++;
+          }
+        }
+        else if (instruction.opcode == END_LOOP)
+        {
+          if (--loopRemaining[depth-1] > 0)
+          {
+            pc = loopStart[depth-1];
+          }
+          else
+          {
+            depth--;
+          }
+        }
+        break;
+    }
+  }
+  if (dirty)
+  {
+    device_.setRegister(reg, value);
+  }
+  return (result);
+}
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef SUBWORD_ACCESS_H
+#define SUBWORD_ACCESS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <BitmapScan.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// This module has the byte lane sub-word bitfield writes for 16 and 32-bit
+// devices whose HW supports byte enables, i.e. a byte or halfword store to a
+// register only updates those bytes.  A bitfield that covers exactly one whole
+// byte, or one whole aligned halfword of a 32-bit register, can then be set
+// with a single narrow store at the right lane address instead of a read-
+// modify-write of the whole register, which saves the read and cannot race
+// with HW updates of the other bytes of the register.
+//
+// The lane address is found by running the bitfield mask through the same
+// endian adjustment as the register value, so it is correct for native,
+// FORCE_BIG_ENDIAN, and FORCE_LITTLE_ENDIAN builds on any host.  This is an
+// opt-in per device capability, see setSubwordAccess in the device classes.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class SubwordAccess
+{
+  public:
+
+    // return the byte offset within the register of a byte or aligned halfword bitfield,
+    // or -1 if the bitfield cannot be written with a single narrow store
+    template <typename T>
+    static int getLaneOffset(unsigned lowOrderBit_, unsigned highOrderBit_);
+
+    // write a byte or halfword bitfield with a single narrow store at the lane offset
+    template <typename T>
+    static void write(volatile T *address_, int laneOffset_, unsigned lowOrderBit_, unsigned highOrderBit_, T value_);
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline int SubwordAccess::getLaneOffset(unsigned lowOrderBit_, unsigned highOrderBit_)
+{
+  unsigned width = highOrderBit_ - lowOrderBit_ + 1;
+  if ((lowOrderBit_ > highOrderBit_) || ((width != 8) && (width != 16)) || (width >= sizeof(T)*8) || ((lowOrderBit_ % width) != 0))
+  {
+    return (-1);
+  }
+
+  // find where the first byte of the bitfield lands in memory
+  T mask = BitmapScan::toRaw((T)(((1u << width) - 1) << lowOrderBit_));
+  const uint8_t *bytes = (const uint8_t *)&mask;
+  for (unsigned i = 0; i < sizeof(T); i++)
+  {
+    if (bytes[i] != 0)
+    {
+      return (i);
+    }
+  }
+  return (-1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void SubwordAccess::write(volatile T *address_, int laneOffset_, unsigned lowOrderBit_, unsigned highOrderBit_, T value_)
+{
+  // build the whole register value in memory order and store just the lane bytes of it
+  T raw = BitmapScan::toRaw((T)(value_ << lowOrderBit_));
+  const uint8_t *bytes = (const uint8_t *)&raw + laneOffset_;
+  volatile uint8_t *lane = (volatile uint8_t *)address_ + laneOffset_;
+  if ((highOrderBit_ - lowOrderBit_) == 7)
+  {
+    *lane = *bytes;
+  }
+  else
+  {
+    uint16_t halfword;
+    memcpy(&halfword, bytes, sizeof(halfword));
+    *(volatile uint16_t *)lane = halfword;
+  }
+}
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef TABLE_LOADER_H
+#define TABLE_LOADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include <BulkBitfield.h>
+#include <ByteSwapCopy.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// This module has the staged bulk loading of large tables (e.g. lookup and
+// classification tables) into device memory, the values are appended to a
+// small cache line aligned staging buffer (endian converted on the way in,
+// the same as writeBlock), and each full staging buffer is written to the
+// table with full cache line (64 byte) non-temporal stores, with a single
+// fence when the load is finished, instead of one uncached store per
+// register, e.g.
+//
+// TableLoader<uint32_t> loader = myTableDevice.getTableLoader(0, tableSize);
+// for (...)
+// {
+//   loader.append(entry);
+// }
+// loader.finish();
+//
+// A partial first/last cache line (a table that does not start/end on a
+// cache line) is written with one store per register.  The full line stores
+// are only for table memory that accepts any write width, not for registers
+// with access semantics, and are best used with a write-combining mapping of
+// the table region (see DeviceDescriptor.h), where each line goes out as a
+// single burst, and the partial line stores are merged in the write-combining
+// buffers until the fence.  The values are streamed out to the table one full
+// staging buffer at a time while appending, so some of them may reach the
+// device before the load is finished, but they are only ordered (fenced) and
+// complete (the last partial staging buffer flushed) once finish (or the
+// destructor) has been called.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+class TableLoader
+{
+  public:
+
+    enum
+    {
+      LINE_BYTES  = 64,
+      STAGE_BYTES = 4096
+    };
+
+    // load up to count values into the table, starting at the first register of the table
+    TableLoader(volatile T *table_, size_t count_);
+    ~TableLoader(){finish();};
+
+    // a loader owns its staged values, it cannot be copied
+    TableLoader(const TableLoader &) = delete;
+    TableLoader &operator=(const TableLoader &) = delete;
+
+    // append endian adjusted values to the table, returns the number appended,
+    // which is less than count if the table is full
+    size_t append(const T *values_, size_t count_);
+    bool append(T value_);
+
+    // write out everything staged and fence, returns the number of values loaded
+    size_t finish(void);
+
+  private:
+
+    enum
+    {
+      LINE_VALUES  = LINE_BYTES/sizeof(T),
+      STAGE_VALUES = STAGE_BYTES/sizeof(T)
+    };
+
+    // write the staged values, a partial last line is only written by the final flush,
+    // a full stage is flushed by the next append, so the last one is written by finish
+    void flush(void);
+
+    alignas(LINE_BYTES) T _stage[STAGE_VALUES];
+    volatile T *_window;    // the cache line aligned table address of _stage[0]
+    size_t _first;          // the first staged value, only non 0 for a table that does not start on a line
+    size_t _fill;           // the next free staging slot
+    size_t _limit;          // the staging slot to flush at, the end of the stage or the table
+    size_t _last;           // the end of the table, in staging slots of the current window
+    size_t _loaded;
+    bool _finished;
+
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+
+namespace BulkBitfieldSimd
+{
+  __attribute__((target("sse2"))) inline void streamLineSse2(volatile void *line_, const void *values_)
+  {
+    __m128i *line = (__m128i *)line_;
+    const __m128i *values = (const __m128i *)values_;
+    _mm_stream_si128(&line[0], _mm_load_si128(&values[0]));
+    _mm_stream_si128(&line[1], _mm_load_si128(&values[1]));
+    _mm_stream_si128(&line[2], _mm_load_si128(&values[2]));
+    _mm_stream_si128(&line[3], _mm_load_si128(&values[3]));
+  }
+
+  __attribute__((target("avx2"))) inline void streamLineAvx2(volatile void *line_, const void *values_)
+  {
+    __m256i *line = (__m256i *)line_;
+    const __m256i *values = (const __m256i *)values_;
+    _mm256_stream_si256(&line[0], _mm256_load_si256(&values[0]));
+    _mm256_stream_si256(&line[1], _mm256_load_si256(&values[1]));
+  }
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline TableLoader<T>::TableLoader(volatile T *table_, size_t count_) :
+  _first(((uintptr_t)table_ % LINE_BYTES)/sizeof(T)),
+  _loaded(0),
+  _finished(false)
+{
+  _window = table_ - _first;
+  _fill = _first;
+  _last = _first + ((table_ == NULL) ? 0 : count_);
+  _limit = (_last < (size_t)STAGE_VALUES) ? _last : (size_t)STAGE_VALUES;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline size_t TableLoader<T>::append(const T *values_, size_t count_)
+{
+  size_t appended = 0;
+  while (appended < count_)
+  {
+    if (_fill == _limit)
+    {
+      if (_fill == _last)
+      {
+        break;
+      }
+      flush();
+    }
+    size_t count = count_ - appended;
+    count = (count < (_limit - _fill)) ? count : (_limit - _fill);
+    if (ByteSwapCopy::needsSwap<T>())
+    {
+      ByteSwapCopy::swap(&_stage[_fill], &values_[appended], count);
+    }
+    else
+    {
+      memcpy(&_stage[_fill], &values_[appended], count*sizeof(T));
+    }
+    _fill += count;
+    appended += count;
+  }
+  return (appended);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline bool TableLoader<T>::append(T value_)
+{
+  if (__builtin_expect(_fill == _limit, 0))
+  {
+    if (_fill == _last)
+    {
+      return (false);
+    }
+    flush();
+  }
+  _stage[_fill++] = BitmapScan::toRaw(value_);
+  return (true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void TableLoader<T>::flush(void)
+{
+  size_t i = _first;
+
+  // the partial first line of a table that does not start on a line
+  if ((_first % LINE_VALUES) != 0)
+  {
+    size_t end = (_first/LINE_VALUES + 1)*LINE_VALUES;
+    for (end = (end < _fill) ? end : _fill; i < end; i++)
+    {
+      _window[i] = _stage[i];
+    }
+  }
+
+  // the full lines
+#if defined(__x86_64__) || defined(__i386__)
+  if (BulkBitfield::getSelectedImplementation() == BulkBitfield::AVX2)
+  {
+    for (; (i + LINE_VALUES) <= _fill; i += LINE_VALUES)
+    {
+      BulkBitfieldSimd::streamLineAvx2(&_window[i], &_stage[i]);
+    }
+  }
+  else
+  {
+    for (; (i + LINE_VALUES) <= _fill; i += LINE_VALUES)
+    {
+      BulkBitfieldSimd::streamLineSse2(&_window[i], &_stage[i]);
+    }
+  }
+#endif
+
+  // the partial last line, or everything without the line stores
+  for (; i < _fill; i++)
+  {
+    _window[i] = _stage[i];
+  }
+
+  _loaded += _fill - _first;
+  _window += _fill;
+  _last -= _fill;
+  _limit = (_last < (size_t)STAGE_VALUES) ? _last : (size_t)STAGE_VALUES;
+  _first = 0;
+  _fill = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline size_t TableLoader<T>::finish(void)
+{
+  if (!_finished)
+  {
+    flush();
+    ByteSwapCopy::fence();
+    _last = _limit = 0;
+    _finished = true;
+  }
+  return (_loaded);
+}
+
+#endif
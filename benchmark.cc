@@ -0,0 +1,1100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <BitBanger.h>
+#include <BitfieldSet.h>
+#include <DeviceFanout.h>
+#include <FieldWatcher.h>
+#include <MemoryMappedDevice.h>
+#include <RegisterBroker.h>
+#include <RegisterProgram.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// this file is a benchmark program for the higher level access modules, all
+// the benchmarks run against RAM based buffers unless noted otherwise, to
+// build this program use the following build command, then run 'benchmark'
+// with the name of the benchmark to run, or no arguments to list them
+//
+// g++ -O2 -I . benchmark.cc -o benchmark -pthread
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// return a monotonic timestamp in nsec
+uint64_t getNsec(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec*1000000000ULL + now.tv_nsec);
+}
+
+// print a single benchmark result line
+void printResult(const char *name_, uint64_t operations_, uint64_t nsec_)
+{
+  printf("  %-40s %12llu ops %10.2f Mops/sec %8.1f nsec/op\n",
+         name_,
+         (unsigned long long)operations_,
+         (nsec_ > 0) ? (operations_*1000.0/nsec_) : 0.0,
+         (operations_ > 0) ? ((double)nsec_/operations_) : 0.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// shared memory register broker vs direct access, the clients are separate
+// processes that attach to the broker by name, the server runs in this process,
+// each client times each of its batches, and the per batch latency distribution
+// of all the clients is reported along with the throughput
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define BROKER_DEVICE_SIZE 64
+#define BROKER_CLIENTS 4
+#define BROKER_BATCHES 20000
+
+// fill in a batch of mostly reads plus some read-modify-writes, the same pattern is used for direct access
+void fillBrokerBatch(RegisterBroker::Request *requests_, unsigned batchSize_, unsigned client_)
+{
+  for (unsigned i = 0; i < batchSize_; i++)
+  {
+    unsigned reg = (client_ + i) % BROKER_DEVICE_SIZE;
+    if ((i % 4) == 3)
+    {
+      requests_[i] = RegisterBrokerClient::makeRequest(RegisterBroker::MODIFY_REGISTER, reg, 1 << client_, 1 << client_);
+    }
+    else
+    {
+      requests_[i] = RegisterBrokerClient::makeRequest(RegisterBroker::GET_REGISTER, reg);
+    }
+  }
+}
+
+// print the percentiles of a set of latencies, sorts them
+void printLatencies(const char *name_, uint32_t *latencies_, unsigned count_)
+{
+  sort(latencies_, latencies_ + count_);
+  printf("  %-40s p50 %8u p90 %8u p99 %8u p99.9 %8u max %8u nsec\n", name_,
+         latencies_[count_/2],
+         latencies_[(uint64_t)count_*90/100],
+         latencies_[(uint64_t)count_*99/100],
+         latencies_[(uint64_t)count_*999/1000],
+         latencies_[count_-1]);
+}
+
+void benchmarkBroker(void)
+{
+  uint32_t buffer[BROKER_DEVICE_SIZE] = {0};
+  MemoryMappedDevice32 device("brokerDevice", buffer, BROKER_DEVICE_SIZE);
+  unsigned batchSizes[] = {1, 16, 128};
+
+  // the clients write their batch latencies here, shared with the forked processes
+  const unsigned numLatencies = BROKER_CLIENTS*BROKER_BATCHES;
+  uint32_t *latencies = (uint32_t *)mmap(NULL, numLatencies*sizeof(uint32_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (latencies == MAP_FAILED)
+  {
+    printf("ERROR: could not map the latency buffer\n");
+    return;
+  }
+
+  printf("\nregister broker, %d client processes, %d batches each:\n\n", BROKER_CLIENTS, BROKER_BATCHES);
+  for (unsigned b = 0; b < sizeof(batchSizes)/sizeof(batchSizes[0]); b++)
+  {
+    unsigned batchSize = batchSizes[b];
+    RegisterBroker::Request requests[128];
+
+    // direct access baseline, single process, no serialization between clients
+    uint64_t start = getNsec();
+    for (unsigned client = 0; client < BROKER_CLIENTS; client++)
+    {
+      fillBrokerBatch(requests, batchSize, client);
+      for (unsigned batch = 0; batch < BROKER_BATCHES; batch++)
+      {
+        for (unsigned i = 0; i < batchSize; i++)
+        {
+          if (requests[i].operation == RegisterBroker::GET_REGISTER)
+          {
+            requests[i].value = device.getRegister(requests[i].register_);
+          }
+          else
+          {
+            uint32_t value = device.getRegister(requests[i].register_);
+            device.setRegister(requests[i].register_, (value & ~requests[i].mask) | (requests[i].value & requests[i].mask));
+          }
+        }
+      }
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "direct, batch size %d", batchSize);
+    printResult(name, (uint64_t)BROKER_CLIENTS*BROKER_BATCHES*batchSize, getNsec()-start);
+    fflush(stdout);
+
+    // brokered access, one client per forked process
+    RegisterBrokerServer server("benchmark", device);
+    if (!server.isReady())
+    {
+      break;
+    }
+    start = getNsec();
+    pid_t pids[BROKER_CLIENTS];
+    for (unsigned client = 0; client < BROKER_CLIENTS; client++)
+    {
+      pids[client] = fork();
+      if (pids[client] == 0)
+      {
+        RegisterBrokerClient brokerClient("benchmark");
+        fillBrokerBatch(requests, batchSize, client);
+        uint32_t *clientLatencies = &latencies[client*BROKER_BATCHES];
+        for (unsigned batch = 0; (batch < BROKER_BATCHES) && brokerClient.isConnected(); batch++)
+        {
+          uint64_t batchStart = getNsec();
+          brokerClient.execute(requests, batchSize);
+          clientLatencies[batch] = (uint32_t)(getNsec() - batchStart);
+        }
+        _exit(brokerClient.isConnected() ? 0 : 1);
+      }
+    }
+    unsigned running = BROKER_CLIENTS;
+    while (running > 0)
+    {
+      if (server.poll() == 0)
+      {
+        int status;
+        if (waitpid(-1, &status, WNOHANG) > 0)
+        {
+          running--;
+        }
+        sched_yield();
+      }
+    }
+    snprintf(name, sizeof(name), "broker, batch size %d", batchSize);
+    printResult(name, (uint64_t)BROKER_CLIENTS*BROKER_BATCHES*batchSize, getNsec()-start);
+    printLatencies("  per batch latency", latencies, numLatencies);
+    fflush(stdout);
+  }
+  munmap(latencies, numLatencies*sizeof(uint32_t));
+
+  // a second server can not take over the region of a live one, and a full width
+  // (0-31) bitfield request is executed, the expected error is logged
+  unsigned errors = 0;
+  RegisterBrokerServer server("benchmark", device);
+  RegisterBrokerServer duplicate("benchmark", device);
+  errors += !server.isReady() + duplicate.isReady();
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    RegisterBrokerClient brokerClient("benchmark");
+    RegisterBroker::Request request = RegisterBrokerClient::makeBitfieldRequest(RegisterBroker::SET_BITFIELD, 0, 0, 31, 0x80000001u);
+    _exit((brokerClient.isConnected() && brokerClient.execute(&request, 1)) ? 0 : 1);
+  }
+  int status = 1;
+  while ((pid > 0) && (waitpid(pid, &status, WNOHANG) == 0))
+  {
+    server.poll();
+  }
+  errors += (pid < 0) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0) || (device.getBitfield(0, 0, 31) != 0x80000001u);
+  printf("  %-40s %12u\n", "verify errors", errors);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// register program interpreter vs the equivalent straight-line setBitfield
+// calls, a typical init sequence sets several fields in each register
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define PROGRAM_DEVICE_SIZE 256
+#define PROGRAM_ITERATIONS 2000
+
+// device that counts its whole register accesses, on real HW each of these is
+// an uncached access that costs far more than the interpreter overhead
+class CountingDevice32 : public MemoryMappedDevice32
+{
+  public:
+    CountingDevice32(const char *name_, void *address_, unsigned size_) : MemoryMappedDevice32(name_, address_, size_), accesses(0) {};
+    void setRegister(unsigned register_, uint32_t value_){accesses++; MemoryMappedDevice32::setRegister(register_, value_);};
+    uint32_t getRegister(unsigned register_){accesses++; return (MemoryMappedDevice32::getRegister(register_));};
+    uint64_t accesses;
+};
+
+void benchmarkProgram(void)
+{
+  uint32_t buffer[PROGRAM_DEVICE_SIZE] = {0};
+  CountingDevice32 device("programDevice", buffer, PROGRAM_DEVICE_SIZE);
+
+  // 4 fields per register, i.e. the interpreter does 1 read and 1 write per register instead of 4 of each
+  vector<RegisterInstruction> program;
+  for (unsigned reg = 0; reg < PROGRAM_DEVICE_SIZE; reg++)
+  {
+    program.push_back(RegisterProgram::setField(reg, 0, 3, reg & 0xf));
+    program.push_back(RegisterProgram::setField(reg, 4, 11, reg & 0xff));
+    program.push_back(RegisterProgram::setField(reg, 12, 12, 1));
+    program.push_back(RegisterProgram::setField(reg, 16, 23, 0x5a));
+  }
+
+  printf("\nregister program, %d registers, 4 fields each, %d iterations:\n\n", PROGRAM_DEVICE_SIZE, PROGRAM_ITERATIONS);
+  uint64_t start = getNsec();
+  for (unsigned i = 0; i < PROGRAM_ITERATIONS; i++)
+  {
+    for (unsigned reg = 0; reg < PROGRAM_DEVICE_SIZE; reg++)
+    {
+      device.setBitfield(reg, 0, 3, reg & 0xf);
+      device.setBitfield(reg, 4, 11, reg & 0xff);
+      device.setBitfield(reg, 12, 12, 1);
+      device.setBitfield(reg, 16, 23, 0x5a);
+    }
+  }
+  printResult("straight-line setBitfield", (uint64_t)PROGRAM_ITERATIONS*program.size(), getNsec()-start);
+  printf("  %-40s %12llu register accesses\n", "", (unsigned long long)PROGRAM_ITERATIONS*program.size()*2);
+
+  start = getNsec();
+  for (unsigned i = 0; i < PROGRAM_ITERATIONS; i++)
+  {
+    RegisterProgram::run(device, program);
+  }
+  printResult("interpreted register program", (uint64_t)PROGRAM_ITERATIONS*program.size(), getNsec()-start);
+  printf("  %-40s %12llu register accesses\n", "", (unsigned long long)device.accesses);
+
+  // full width fields, a max value that does not fit would be rejected as invalid
+  const RegisterInstruction fullWidth[] =
+  {
+    RegisterProgram::setField(0, 0, 31, 0xffffffffu),
+    RegisterProgram::poll(0, 0, 31, 0xffffffffu, 0),
+    RegisterProgram::setField(1, 0, 31, 0x12345678u)
+  };
+  RegisterProgram::Result result = RegisterProgram::run(device, fullWidth);
+  unsigned errors = (result.status != RegisterProgram::OK) + (device.getBitfield(0, 0, 31) != 0xffffffffu) + (device.getBitfield(1, 0, 31) != 0x12345678u);
+  printf("  %-40s %12u\n", "verify errors", errors);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// fan-out of one init program to many identical devices, a serial loop over
+// the devices vs DeviceFanout with one worker per CPU, on RAM devices, and on
+// devices that stall on every register access like an uncached PCIe access,
+// which is where the workers pay off, the speedup is bounded by the CPUs
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define FANOUT_DEVICES 64
+#define FANOUT_DEVICE_SIZE 64
+#define FANOUT_ITERATIONS 20
+#define FANOUT_STALL_NSEC 500
+
+// device that busy waits on every whole register access, i.e. holds the CPU like an
+// uncached read would, a bitfield write is a read and a write
+class StallingDevice32 : public MemoryMappedDevice32
+{
+  public:
+    StallingDevice32(const char *name_, void *address_, unsigned size_, uint64_t stallNsec_) : MemoryMappedDevice32(name_, address_, size_), _stallNsec(stallNsec_) {};
+    void setRegister(unsigned register_, uint32_t value_){stall(1); MemoryMappedDevice32::setRegister(register_, value_);};
+    uint32_t getRegister(unsigned register_){stall(1); return (MemoryMappedDevice32::getRegister(register_));};
+    void setBitfield(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_, uint32_t value_){stall(2); MemoryMappedDevice32::setBitfield(register_, lowOrderBit_, highOrderBit_, value_);};
+    uint32_t getBitfield(unsigned register_, unsigned lowOrderBit_, unsigned highOrderBit_){stall(1); return (MemoryMappedDevice32::getBitfield(register_, lowOrderBit_, highOrderBit_));};
+  private:
+    void stall(unsigned accesses_){if (_stallNsec != 0){uint64_t end = getNsec() + accesses_*_stallNsec; while (getNsec() < end);}};
+    uint64_t _stallNsec;
+};
+
+void runFanout(DeviceFanout<StallingDevice32> &fanout_, vector<StallingDevice32 *> &devices_, const DeviceFanout<StallingDevice32>::Program &program_, const vector<DeviceFanout<StallingDevice32>::Parameters> &parameters_, unsigned iterations_)
+{
+  typedef DeviceFanout<StallingDevice32> Fanout;
+  uint64_t operations = (uint64_t)iterations_*devices_.size()*program_.size();
+  uint64_t start = getNsec();
+  for (unsigned i = 0; i < iterations_; i++)
+  {
+    for (unsigned j = 0; j < devices_.size(); j++)
+    {
+      for (unsigned k = 0; k < program_.size(); k++)
+      {
+        const Fanout::Step &step = program_[k];
+        uint32_t value = (step.parameter != Fanout::NO_PARAMETER) ? parameters_[j][step.parameter] : step.value;
+        devices_[j]->setBitfield(step.register_, step.lowOrderBit, step.highOrderBit, value);
+      }
+    }
+  }
+  printResult("serial loop over the devices", operations, getNsec()-start);
+
+  vector<Fanout::Result> results;
+  unsigned failed = 0;
+  start = getNsec();
+  for (unsigned i = 0; i < iterations_; i++)
+  {
+    failed += !fanout_.execute(devices_, program_, parameters_, results);
+  }
+  printResult("DeviceFanout execute", operations, getNsec()-start);
+  printf("  %-40s %12u\n", "failed executes", failed);
+}
+
+void benchmarkFanout(void)
+{
+  typedef DeviceFanout<StallingDevice32> Fanout;
+  DeviceFanout<StallingDevice32> fanout;
+
+  // 2 fields per register, one of them a per device parameter
+  Fanout::Program program;
+  for (unsigned reg = 0; reg < FANOUT_DEVICE_SIZE; reg++)
+  {
+    program.push_back(Fanout::setBitfield(reg, 0, 7, reg));
+    program.push_back(Fanout::setBitfieldParameter(reg, 8, 15, 0));
+  }
+  vector<Fanout::Parameters> parameters(FANOUT_DEVICES);
+  for (unsigned i = 0; i < FANOUT_DEVICES; i++)
+  {
+    parameters[i].push_back(i);
+  }
+
+  vector<vector<uint32_t>> buffers(2*FANOUT_DEVICES, vector<uint32_t>(FANOUT_DEVICE_SIZE));
+  vector<StallingDevice32> ramDevices;
+  vector<StallingDevice32> stallingDevices;
+  vector<StallingDevice32 *> ramPointers;
+  vector<StallingDevice32 *> stallingPointers;
+  ramDevices.reserve(FANOUT_DEVICES);
+  stallingDevices.reserve(FANOUT_DEVICES);
+  for (unsigned i = 0; i < FANOUT_DEVICES; i++)
+  {
+    ramDevices.emplace_back("fanoutDevice", buffers[i].data(), FANOUT_DEVICE_SIZE, 0);
+    stallingDevices.emplace_back("fanoutDevice", buffers[FANOUT_DEVICES + i].data(), FANOUT_DEVICE_SIZE, FANOUT_STALL_NSEC);
+    ramPointers.push_back(&ramDevices.back());
+    stallingPointers.push_back(&stallingDevices.back());
+  }
+
+  printf("\ndevice fan-out, %d devices, %d bitfield writes each, %d worker threads + caller:\n\n", FANOUT_DEVICES, (unsigned)program.size(), fanout.getNumThreads());
+  printf("  RAM devices, %d iterations:\n", FANOUT_ITERATIONS*100);
+  runFanout(fanout, ramPointers, program, parameters, FANOUT_ITERATIONS*100);
+  printf("\n  devices stalling %d nsec per register access, %d iterations:\n", FANOUT_STALL_NSEC, FANOUT_ITERATIONS);
+  runFanout(fanout, stallingPointers, program, parameters, FANOUT_ITERATIONS);
+
+  unsigned errors = 0;
+  for (unsigned i = 0; i < FANOUT_DEVICES; i++)
+  {
+    for (unsigned reg = 0; reg < FANOUT_DEVICE_SIZE; reg++)
+    {
+      errors += (ramDevices[i].getBitfield(reg, 0, 15) != ((i << 8) | reg)) + (stallingDevices[i].getBitfield(reg, 0, 15) != ((i << 8) | reg));
+    }
+  }
+
+  // full width (0-31) steps, a max value that does not fit would fail the step
+  Fanout::Program fullWidth;
+  fullWidth.push_back(Fanout::setBitfield(0, 0, 31, 0xffffffffu));
+  fullWidth.push_back(Fanout::setBitfieldParameter(1, 0, 31, 0));
+  for (unsigned i = 0; i < FANOUT_DEVICES; i++)
+  {
+    parameters[i][0] = 0x80000000u | i;
+  }
+  vector<Fanout::Result> results;
+  errors += !fanout.execute(ramPointers, fullWidth, parameters, results);
+  for (unsigned i = 0; i < FANOUT_DEVICES; i++)
+  {
+    errors += (ramDevices[i].getBitfield(0, 0, 31) != 0xffffffffu) + (ramDevices[i].getBitfield(1, 0, 31) != (0x80000000u | i));
+  }
+  printf("  %-40s %12u\n", "verify errors", errors);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// multi-field decode of captured register values, per-field getBitfield vs a
+// BitfieldSet, and the packed extract with the portable and BMI2 versions
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define FIELDSET_VALUES (1024*1024)
+#define FIELDSET_ITERATIONS 20
+
+void benchmarkFieldset(void)
+{
+  static const Bitfield bitfields[] = {{0, 3}, {4, 7}, {8, 8}, {9, 11}, {12, 15}, {16, 19}, {20, 27}, {28, 31}};
+  const unsigned numFields = sizeof(bitfields)/sizeof(bitfields[0]);
+  BitfieldSet<uint32_t> fieldSet(bitfields, numFields);
+  vector<uint32_t> values(FIELDSET_VALUES);
+  vector<uint32_t> fields(FIELDSET_VALUES*numFields);
+  uint32_t checksum = 0;
+  for (unsigned i = 0; i < FIELDSET_VALUES; i++)
+  {
+    values[i] = i*2654435761u;
+  }
+
+  printf("\nmulti-field decode, %d values, %d fields each, %d iterations:\n\n", FIELDSET_VALUES, numFields, FIELDSET_ITERATIONS);
+  uint64_t start = getNsec();
+  for (unsigned i = 0; i < FIELDSET_ITERATIONS; i++)
+  {
+    for (unsigned j = 0; j < FIELDSET_VALUES; j++)
+    {
+      for (unsigned k = 0; k < numFields; k++)
+      {
+        fields[j*numFields + k] = BitBanger::getBitfield(values[j], bitfields[k].lowOrderBit, bitfields[k].highOrderBit);
+      }
+    }
+    checksum += fields[i];
+  }
+  printResult("getBitfield per field", (uint64_t)FIELDSET_ITERATIONS*FIELDSET_VALUES, getNsec()-start);
+
+  start = getNsec();
+  for (unsigned i = 0; i < FIELDSET_ITERATIONS; i++)
+  {
+    fieldSet.extract(values.data(), fields.data(), FIELDSET_VALUES);
+    checksum += fields[i];
+  }
+  printResult("BitfieldSet extract", (uint64_t)FIELDSET_ITERATIONS*FIELDSET_VALUES, getNsec()-start);
+
+  BitfieldSet<uint32_t>::setImplementation(BitfieldSet<uint32_t>::PORTABLE);
+  start = getNsec();
+  for (unsigned i = 0; i < FIELDSET_ITERATIONS; i++)
+  {
+    fieldSet.extractPacked(values.data(), fields.data(), FIELDSET_VALUES);
+    checksum += fields[i];
+  }
+  printResult("BitfieldSet extractPacked, portable", (uint64_t)FIELDSET_ITERATIONS*FIELDSET_VALUES, getNsec()-start);
+
+  BitfieldSet<uint32_t>::setImplementation(BitfieldSet<uint32_t>::BMI2);
+  if (BitfieldSet<uint32_t>::isUsingBmi2())
+  {
+    start = getNsec();
+    for (unsigned i = 0; i < FIELDSET_ITERATIONS; i++)
+    {
+      fieldSet.extractPacked(values.data(), fields.data(), FIELDSET_VALUES);
+      checksum += fields[i];
+    }
+    printResult("BitfieldSet extractPacked, BMI2", (uint64_t)FIELDSET_ITERATIONS*FIELDSET_VALUES, getNsec()-start);
+  }
+  else
+  {
+    printf("  %-40s not supported by this CPU\n", "BitfieldSet extractPacked, BMI2");
+  }
+  BitfieldSet<uint32_t>::setImplementation(BitfieldSet<uint32_t>::AUTO);
+  printf("  %-40s %12u\n", "checksum", checksum);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// single field decode of a buffer of captured 16 and 32-bit register values,
+// getBitfield per value vs the array versions with each implementation, the
+// buffer fits in the L2 cache so this measures the decode, not the memory
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define BULK_VALUES 16384
+#define BULK_ITERATIONS 5000
+
+template <typename T>
+void benchmarkBulkWidth(void)
+{
+  vector<T> values(BULK_VALUES);
+  vector<T> fields(BULK_VALUES);
+  char name[64];
+  uint64_t checksum = 0;
+  for (unsigned i = 0; i < BULK_VALUES; i++)
+  {
+    values[i] = (T)(i*2654435761u);
+  }
+
+  printf("\nbulk %d-bit field extract, %d values, %d iterations:\n\n", (unsigned)sizeof(T)*8, BULK_VALUES, BULK_ITERATIONS);
+  uint64_t start = getNsec();
+  for (unsigned i = 0; i < BULK_ITERATIONS; i++)
+  {
+    for (unsigned j = 0; j < BULK_VALUES; j++)
+    {
+      fields[j] = BitBanger::getBitfield(values[j], 4, 11);
+    }
+    checksum += fields[i];
+  }
+  printResult("getBitfield per value", (uint64_t)BULK_ITERATIONS*BULK_VALUES, getNsec()-start);
+
+  static const BulkBitfield::Implementation implementations[] = {BulkBitfield::SCALAR, BulkBitfield::SSSE3, BulkBitfield::AVX2};
+  static const char *implementationNames[] = {"scalar", "SSSE3", "AVX2"};
+  for (unsigned impl = 0; impl < 3; impl++)
+  {
+    BulkBitfield::setImplementation(implementations[impl]);
+    if (BulkBitfield::getSelectedImplementation() != implementations[impl])
+    {
+      printf("  %s not supported by this CPU\n", implementationNames[impl]);
+      continue;
+    }
+    snprintf(name, sizeof(name), "getBitfields, %s", implementationNames[impl]);
+    start = getNsec();
+    for (unsigned i = 0; i < BULK_ITERATIONS; i++)
+    {
+      BitBanger::getBitfields(values.data(), BULK_VALUES, 4, 11, fields.data());
+      checksum += fields[i];
+    }
+    printResult(name, (uint64_t)BULK_ITERATIONS*BULK_VALUES, getNsec()-start);
+
+    snprintf(name, sizeof(name), "countBitfieldMatches, %s", implementationNames[impl]);
+    start = getNsec();
+    for (unsigned i = 0; i < BULK_ITERATIONS; i++)
+    {
+      checksum += BitBanger::countBitfieldMatches(values.data(), BULK_VALUES, 4, 11, (T)0x5a);
+    }
+    printResult(name, (uint64_t)BULK_ITERATIONS*BULK_VALUES, getNsec()-start);
+  }
+  BulkBitfield::setImplementation(BulkBitfield::AUTO);
+  printf("  %-40s %12llu\n", "checksum", (unsigned long long)checksum);
+}
+
+void benchmarkBulk(void)
+{
+  benchmarkBulkWidth<uint16_t>();
+  benchmarkBulkWidth<uint32_t>();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// coroutine field waits, 10k concurrent waits on queue completion bits spread
+// over RAM based devices, completed a fraction per round by the simulated HW,
+// vs polling each pending wait's bitfield individually every round, needs a
+// C++20 build, e.g. add -std=c++20 to the build command
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define FIELDWAIT_DEVICES 40
+#define FIELDWAIT_REGISTERS 16
+#define FIELDWAIT_WAITS 10000
+#define FIELDWAIT_ROUNDS 16
+
+#if defined(__cpp_impl_coroutine)
+
+// the round in which the simulated HW completes a wait
+unsigned getFieldWaitRound(unsigned wait_)
+{
+  return ((wait_*2654435761u >> 16) % FIELDWAIT_ROUNDS);
+}
+
+FieldWaitTask waitForCompletion(MemoryMappedDevice32 &device_, unsigned register_, unsigned bit_, unsigned &completed_)
+{
+  bool done = co_await device_.fieldEquals(register_, bit_, bit_, 1);
+  if (done)
+  {
+    completed_++;
+  }
+}
+
+// awaits directly in the if condition, counts a wait that did not end as expected_
+FieldWaitTask verifyWait(MemoryMappedDevice32 &device_, unsigned bit_, unsigned expected_, unsigned &errors_)
+{
+  unsigned wakes = 0;
+  if (co_await device_.fieldEquals(0, bit_, bit_, 1, 1000))
+  {
+    wakes++;
+  }
+  errors_ += (wakes != expected_);
+}
+
+void benchmarkFieldWait(void)
+{
+  static uint32_t buffers[FIELDWAIT_DEVICES][FIELDWAIT_REGISTERS];
+  vector<MemoryMappedDevice32> devices;
+  devices.reserve(FIELDWAIT_DEVICES);
+  for (unsigned i = 0; i < FIELDWAIT_DEVICES; i++)
+  {
+    devices.emplace_back("waitDevice", buffers[i], FIELDWAIT_REGISTERS);
+  }
+  FieldWaitScheduler &scheduler = FieldWaitScheduler::getDefault();
+
+  printf("\nfield waits, %d waits, %d devices, %d registers each, %d rounds:\n\n", FIELDWAIT_WAITS, FIELDWAIT_DEVICES, FIELDWAIT_REGISTERS, FIELDWAIT_ROUNDS);
+
+  // individual polling, every round each pending wait reads its own register
+  memset(buffers, 0, sizeof(buffers));
+  vector<bool> done(FIELDWAIT_WAITS, false);
+  uint64_t reads = 0;
+  unsigned completed = 0;
+  uint64_t start = getNsec();
+  for (unsigned round = 0; round < FIELDWAIT_ROUNDS; round++)
+  {
+    for (unsigned i = 0; i < FIELDWAIT_WAITS; i++)
+    {
+      if (getFieldWaitRound(i) == round)
+      {
+        BitBanger::setBitfield(buffers[i/(FIELDWAIT_REGISTERS*32)][(i/32)%FIELDWAIT_REGISTERS], i%32, i%32, (uint32_t)1);
+      }
+    }
+    for (unsigned i = 0; i < FIELDWAIT_WAITS; i++)
+    {
+      if (!done[i])
+      {
+        reads++;
+        if (devices[i/(FIELDWAIT_REGISTERS*32)].getBitfield((i/32)%FIELDWAIT_REGISTERS, i%32, i%32) == 1)
+        {
+          done[i] = true;
+          completed++;
+        }
+      }
+    }
+  }
+  printResult("individual bitfield polling", completed, getNsec()-start);
+  printf("  %-40s %12llu register reads\n", "", (unsigned long long)reads);
+
+  // coroutine waits, one scheduler sweep per round
+  memset(buffers, 0, sizeof(buffers));
+  completed = 0;
+  start = getNsec();
+  for (unsigned i = 0; i < FIELDWAIT_WAITS; i++)
+  {
+    waitForCompletion(devices[i/(FIELDWAIT_REGISTERS*32)], (i/32)%FIELDWAIT_REGISTERS, i%32, completed);
+  }
+  for (unsigned round = 0; round < FIELDWAIT_ROUNDS; round++)
+  {
+    for (unsigned i = 0; i < FIELDWAIT_WAITS; i++)
+    {
+      if (getFieldWaitRound(i) == round)
+      {
+        BitBanger::setBitfield(buffers[i/(FIELDWAIT_REGISTERS*32)][(i/32)%FIELDWAIT_REGISTERS], i%32, i%32, (uint32_t)1);
+      }
+    }
+    scheduler.poll();
+  }
+  printResult("coroutine waits, coalesced sweeps", completed, getNsec()-start);
+  printf("  %-40s %12llu register reads, %d still pending\n", "", (unsigned long long)scheduler.getReadCount(), scheduler.getPendingCount());
+
+  // the even bits are set, so their waits complete, the odd ones time out
+  uint32_t verifyBuffer[1] = {0x55555555u};
+  MemoryMappedDevice32 verifyDevice("verifyDevice", verifyBuffer, 1);
+  unsigned errors = 0;
+  for (unsigned bit = 0; bit < 32; bit++)
+  {
+    verifyWait(verifyDevice, bit, (bit + 1)%2, errors);
+  }
+  scheduler.run();
+  printf("  %-40s %12u\n", "verify errors", errors);
+}
+
+#else
+
+void benchmarkFieldWait(void)
+{
+  printf("\nfield waits: not built, the coroutine waits need a C++20 build, e.g. -std=c++20\n");
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// field watcher, several monitors of the same status fields each polling them
+// on their own vs one watcher sweep publishing the changes to all of them
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define WATCH_REGISTERS 16
+#define WATCH_FIELDS_PER_REGISTER 4
+#define WATCH_MONITORS 4
+#define WATCH_SWEEPS 20000
+
+// the simulated HW changes one register per sweep
+void changeWatchedRegister(uint32_t *buffer_, unsigned sweep_)
+{
+  buffer_[sweep_ % WATCH_REGISTERS] += 0x01010101;
+}
+
+void benchmarkWatch(void)
+{
+  uint32_t buffer[WATCH_REGISTERS] = {0};
+  CountingDevice32 device("watchDevice", buffer, WATCH_REGISTERS);
+  const unsigned numFields = WATCH_REGISTERS*WATCH_FIELDS_PER_REGISTER;
+  vector<uint32_t> values(WATCH_MONITORS*numFields, 0);
+  uint64_t changes = 0;
+
+  printf("\nfield watcher, %d fields in %d registers, %d monitors, %d sweeps:\n\n", numFields, WATCH_REGISTERS, WATCH_MONITORS, WATCH_SWEEPS);
+  uint64_t start = getNsec();
+  for (unsigned sweep = 0; sweep < WATCH_SWEEPS; sweep++)
+  {
+    changeWatchedRegister(buffer, sweep);
+    for (unsigned monitor = 0; monitor < WATCH_MONITORS; monitor++)
+    {
+      for (unsigned field = 0; field < numFields; field++)
+      {
+        unsigned lowOrderBit = (field % WATCH_FIELDS_PER_REGISTER)*8;
+        uint32_t value = device.getBitfield(field/WATCH_FIELDS_PER_REGISTER, lowOrderBit, lowOrderBit + 7);
+        changes += (value != values[monitor*numFields + field]);
+        values[monitor*numFields + field] = value;
+      }
+    }
+  }
+  printResult("each monitor polling every field", changes, getNsec()-start);
+  printf("  %-40s %12llu register reads\n", "", (unsigned long long)WATCH_SWEEPS*WATCH_MONITORS*numFields);
+
+  memset(buffer, 0, sizeof(buffer));
+  changes = 0;
+  FieldWatcher watcher(0);
+  FieldWatcher::Subscriber *subscribers[WATCH_MONITORS];
+  FieldWatcher::Event event;
+  for (unsigned field = 0; field < numFields; field++)
+  {
+    unsigned lowOrderBit = (field % WATCH_FIELDS_PER_REGISTER)*8;
+    watcher.addField(device, field/WATCH_FIELDS_PER_REGISTER, lowOrderBit, lowOrderBit + 7);
+  }
+  for (unsigned monitor = 0; monitor < WATCH_MONITORS; monitor++)
+  {
+    subscribers[monitor] = watcher.subscribe();
+  }
+  start = getNsec();
+  for (unsigned sweep = 0; sweep < WATCH_SWEEPS; sweep++)
+  {
+    changeWatchedRegister(buffer, sweep);
+    watcher.sweep();
+    for (unsigned monitor = 0; monitor < WATCH_MONITORS; monitor++)
+    {
+      while (subscribers[monitor]->pop(event))
+      {
+        changes++;
+      }
+    }
+  }
+  printResult("watcher sweep, events to each monitor", changes, getNsec()-start);
+  printf("  %-40s %12llu register reads\n", "", (unsigned long long)device.accesses);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// device startup, thousands of small sub-devices of one file backed "device",
+// mapping each device on its own as it is constructed vs lazy construction
+// from descriptors and one batched mapAll, the mapping messages are dropped
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define STARTUP_DEVICES 4096
+#define STARTUP_DEVICE_SIZE 64
+#define STARTUP_FILE "/tmp/bitBangerStartup.bin"
+
+void benchmarkStartup(void)
+{
+  // a file is as good as /dev/mem for timing the open/mmap, and needs no privileges
+  int fd = open(STARTUP_FILE, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if ((fd < 0) || (ftruncate(fd, STARTUP_DEVICES*STARTUP_DEVICE_SIZE*sizeof(uint32_t)) != 0))
+  {
+    printf("ERROR: could not create: %s\n", STARTUP_FILE);
+    return;
+  }
+  close(fd);
+  vector<DeviceDescriptor> descriptors;
+  for (unsigned i = 0; i < STARTUP_DEVICES; i++)
+  {
+    descriptors.push_back({"startupDevice", i*STARTUP_DEVICE_SIZE*sizeof(uint32_t), STARTUP_DEVICE_SIZE, STARTUP_FILE});
+  }
+  DeviceLog::setSink(NULL);
+
+  printf("\ndevice startup, %d devices, %d registers each:\n\n", STARTUP_DEVICES, STARTUP_DEVICE_SIZE);
+  {
+    vector<MemoryMappedDevice32> devices;
+    devices.reserve(STARTUP_DEVICES);
+    uint64_t start = getNsec();
+    for (unsigned i = 0; i < STARTUP_DEVICES; i++)
+    {
+      devices.emplace_back(descriptors[i]);
+      devices.back().map();
+    }
+    printResult("construct and map each device", STARTUP_DEVICES, getNsec()-start);
+  }
+  {
+    vector<MemoryMappedDevice32> devices;
+    devices.reserve(STARTUP_DEVICES);
+    uint64_t start = getNsec();
+    for (unsigned i = 0; i < STARTUP_DEVICES; i++)
+    {
+      devices.emplace_back(descriptors[i]);
+    }
+    printResult("construct from descriptors, lazy", STARTUP_DEVICES, getNsec()-start);
+
+    vector<MemoryMappedDevice32 *> pointers;
+    for (unsigned i = 0; i < STARTUP_DEVICES; i++)
+    {
+      pointers.push_back(&devices[i]);
+    }
+    start = getNsec();
+    unsigned mapped = DeviceMapper::mapAll(pointers.data(), STARTUP_DEVICES);
+    printResult("batched mapAll", mapped, getNsec()-start);
+  }
+  unlink(STARTUP_FILE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// endian converting table writes/reads of 16, 32, and 64-bit values, a swap
+// and store per value vs the ByteSwapCopy block copies with each
+// implementation, to a RAM region and through the MMIO path (one non-temporal
+// store per register), and a 32-bit device table load with setRegister per
+// register vs writeBlock, the table fits in the L2 cache.  The MMIO path runs
+// on cached RAM here, where its non-temporal stores bypass the cache, so it is
+// no faster (and often slower) than the swap and store per value, it only
+// shows what the path costs, its gain over uncached stores needs real HW
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define SWAP_VALUES 16384
+#define SWAP_ITERATIONS 2000
+
+template <typename T>
+void benchmarkByteSwapWidth(void)
+{
+  vector<T> values(SWAP_VALUES);
+  vector<T> table(SWAP_VALUES);
+  volatile T *device = table.data();
+  char name[64];
+  uint64_t checksum = 0;
+  for (unsigned i = 0; i < SWAP_VALUES; i++)
+  {
+    values[i] = (T)(i*0x9E3779B97F4A7C15ULL);
+  }
+
+  printf("\n%d-bit byte swapped table copy, %d values, %d iterations:\n\n", (unsigned)sizeof(T)*8, SWAP_VALUES, SWAP_ITERATIONS);
+  uint64_t start = getNsec();
+  for (unsigned i = 0; i < SWAP_ITERATIONS; i++)
+  {
+    for (unsigned j = 0; j < SWAP_VALUES; j++)
+    {
+      device[j] = BitmapScan::toRaw(values[j]);
+    }
+    checksum += table[i];
+  }
+  printResult("swap and store per value", (uint64_t)SWAP_ITERATIONS*SWAP_VALUES, getNsec()-start);
+
+  static const BulkBitfield::Implementation implementations[] = {BulkBitfield::SCALAR, BulkBitfield::SSSE3, BulkBitfield::AVX2};
+  static const char *implementationNames[] = {"scalar", "SSSE3", "AVX2"};
+  for (unsigned impl = 0; impl < 3; impl++)
+  {
+    BulkBitfield::setImplementation(implementations[impl]);
+    if (BulkBitfield::getSelectedImplementation() != implementations[impl])
+    {
+      printf("  %s not supported by this CPU\n", implementationNames[impl]);
+      continue;
+    }
+    snprintf(name, sizeof(name), "toDevice RAM, %s", implementationNames[impl]);
+    start = getNsec();
+    for (unsigned i = 0; i < SWAP_ITERATIONS; i++)
+    {
+      ByteSwapCopy::toDevice(device, values.data(), SWAP_VALUES, ByteSwapCopy::RAM);
+      checksum += table[i];
+    }
+    printResult(name, (uint64_t)SWAP_ITERATIONS*SWAP_VALUES, getNsec()-start);
+
+    snprintf(name, sizeof(name), "toDevice MMIO, %s", implementationNames[impl]);
+    start = getNsec();
+    for (unsigned i = 0; i < SWAP_ITERATIONS; i++)
+    {
+      ByteSwapCopy::toDevice(device, values.data(), SWAP_VALUES, ByteSwapCopy::MMIO);
+      checksum += table[i];
+    }
+    printResult(name, (uint64_t)SWAP_ITERATIONS*SWAP_VALUES, getNsec()-start);
+
+    snprintf(name, sizeof(name), "fromDevice MMIO, %s", implementationNames[impl]);
+    start = getNsec();
+    for (unsigned i = 0; i < SWAP_ITERATIONS; i++)
+    {
+      ByteSwapCopy::fromDevice(values.data(), device, SWAP_VALUES, ByteSwapCopy::MMIO);
+      checksum += values[i];
+    }
+    printResult(name, (uint64_t)SWAP_ITERATIONS*SWAP_VALUES, getNsec()-start);
+  }
+  BulkBitfield::setImplementation(BulkBitfield::AUTO);
+  printf("  %-40s %12llu\n", "checksum", (unsigned long long)checksum);
+}
+
+void benchmarkByteSwap(void)
+{
+  benchmarkByteSwapWidth<uint16_t>();
+  benchmarkByteSwapWidth<uint32_t>();
+  benchmarkByteSwapWidth<uint64_t>();
+
+  // the device level table load, the address constructor takes the MMIO path
+  vector<uint32_t> values(SWAP_VALUES);
+  vector<uint32_t> table(SWAP_VALUES);
+  for (unsigned i = 0; i < SWAP_VALUES; i++)
+  {
+    values[i] = i*2654435761u;
+  }
+  MemoryMappedDevice32 ramDevice("swapDevice", table.data(), SWAP_VALUES);
+  MemoryMappedDevice32 mmioDevice("swapDevice", (unsigned long)table.data(), SWAP_VALUES);
+
+  printf("\n32-bit device table load, %d registers, %d iterations:\n\n", SWAP_VALUES, SWAP_ITERATIONS);
+  uint64_t start = getNsec();
+  for (unsigned i = 0; i < SWAP_ITERATIONS; i++)
+  {
+    for (unsigned j = 0; j < SWAP_VALUES; j++)
+    {
+      ramDevice.setRegister(j, NTOHL(values[j]));
+    }
+  }
+  printResult("setRegister per register", (uint64_t)SWAP_ITERATIONS*SWAP_VALUES, getNsec()-start);
+
+  start = getNsec();
+  for (unsigned i = 0; i < SWAP_ITERATIONS; i++)
+  {
+    ramDevice.writeBlock(0, SWAP_VALUES, values.data());
+  }
+  printResult("writeBlock, RAM", (uint64_t)SWAP_ITERATIONS*SWAP_VALUES, getNsec()-start);
+
+  start = getNsec();
+  for (unsigned i = 0; i < SWAP_ITERATIONS; i++)
+  {
+    mmioDevice.writeBlock(0, SWAP_VALUES, values.data());
+  }
+  printResult("writeBlock, MMIO path", (uint64_t)SWAP_ITERATIONS*SWAP_VALUES, getNsec()-start);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// multi-megabyte table load, setRegister per register vs writeBlock vs the
+// staged loadTable (full cache line non-temporal stores, one fence), on a RAM
+// based region, and on a real device if TABLE_DEVICE is set in the
+// environment (e.g. a PCI sysfs resourceN file, as root), with the optional
+// TABLE_ADDRESS (offset) and TABLE_SIZE (in registers), the per register
+// writes go through an uncached mapping, and loadTable through a
+// write-combining mapping of the TABLE_DEVICE path with "_wc" appended if
+// there is one (e.g. resource2_wc), otherwise through the uncached one, the
+// device table region is overwritten
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define TABLE_REGISTERS (1024*1024)
+#define TABLE_ITERATIONS 50
+
+void runTableLoad(MemoryMappedDevice32 &device_, MemoryMappedDevice32 &tableDevice_, const vector<uint32_t> &values_, unsigned iterations_)
+{
+  unsigned count = values_.size();
+  uint64_t start = getNsec();
+  for (unsigned i = 0; i < iterations_; i++)
+  {
+    for (unsigned j = 0; j < count; j++)
+    {
+      device_.setRegister(j, NTOHL(values_[j]));
+    }
+  }
+  printResult("setRegister per register", (uint64_t)iterations_*count, getNsec()-start);
+
+  start = getNsec();
+  for (unsigned i = 0; i < iterations_; i++)
+  {
+    device_.writeBlock(0, count, values_.data());
+  }
+  printResult("writeBlock", (uint64_t)iterations_*count, getNsec()-start);
+
+  start = getNsec();
+  for (unsigned i = 0; i < iterations_; i++)
+  {
+    tableDevice_.loadTable(0, count, values_.data());
+  }
+  printResult("loadTable", (uint64_t)iterations_*count, getNsec()-start);
+
+  start = getNsec();
+  for (unsigned i = 0; i < iterations_; i++)
+  {
+    TableLoader<uint32_t> loader = tableDevice_.getTableLoader(0, count);
+    for (unsigned j = 0; j < count; j++)
+    {
+      loader.append(values_[j]);
+    }
+  }
+  printResult("getTableLoader, append per value", (uint64_t)iterations_*count, getNsec()-start);
+
+  unsigned errors = 0;
+  for (unsigned j = 0; j < count; j++)
+  {
+    errors += (device_.getRegister(j) != NTOHL(values_[j]));
+  }
+  printf("  %-40s %12u\n", "verify errors", errors);
+}
+
+void benchmarkTableLoad(void)
+{
+  vector<uint32_t> values(TABLE_REGISTERS);
+  for (unsigned i = 0; i < TABLE_REGISTERS; i++)
+  {
+    values[i] = i*2654435761u;
+  }
+
+  {
+    vector<uint32_t> table(TABLE_REGISTERS);
+    MemoryMappedDevice32 device("tableDevice", table.data(), TABLE_REGISTERS);
+    printf("\ntable load, RAM, %d registers, %d iterations:\n\n", TABLE_REGISTERS, TABLE_ITERATIONS);
+    runTableLoad(device, device, values, TABLE_ITERATIONS);
+  }
+
+  const char *path = getenv("TABLE_DEVICE");
+  if (path == NULL)
+  {
+    printf("\n  set TABLE_DEVICE (and TABLE_ADDRESS, TABLE_SIZE) to also load a device table\n");
+    return;
+  }
+  unsigned long address = (getenv("TABLE_ADDRESS") != NULL) ? strtoul(getenv("TABLE_ADDRESS"), NULL, 0) : 0;
+  unsigned size = (getenv("TABLE_SIZE") != NULL) ? strtoul(getenv("TABLE_SIZE"), NULL, 0) : TABLE_REGISTERS;
+  values.resize((size < TABLE_REGISTERS) ? size : TABLE_REGISTERS);
+  string wcPath = string(path) + "_wc";
+  bool writeCombining = (access(wcPath.c_str(), F_OK) == 0);
+  DeviceDescriptor descriptors[] =
+  {
+    {"tableDevice", address, (unsigned)values.size(), path},
+    {"tableDeviceWc", address, (unsigned)values.size(), wcPath, true},
+  };
+  MemoryMappedDevice32 device(descriptors[0]);
+  MemoryMappedDevice32 tableDevice(descriptors[1]);
+  if (!device.map() || (writeCombining && !tableDevice.map()))
+  {
+    return;
+  }
+  printf("\ntable load, %s, %u registers, 1 iteration, loadTable %s:\n\n", path, (unsigned)values.size(), writeCombining ? "write-combining" : "uncached");
+  runTableLoad(device, writeCombining ? tableDevice : device, values, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// main, run the benchmark(s) named on the command line
+//
+////////////////////////////////////////////////////////////////////////////////
+
+struct Benchmark
+{
+  const char *name;
+  void (*function)(void);
+};
+
+Benchmark benchmarks[] =
+{
+  {"broker", benchmarkBroker},
+  {"program", benchmarkProgram},
+  {"fanout", benchmarkFanout},
+  {"fieldset", benchmarkFieldset},
+  {"bulk", benchmarkBulk},
+  {"fieldwait", benchmarkFieldWait},
+  {"watch", benchmarkWatch},
+  {"startup", benchmarkStartup},
+  {"byteswap", benchmarkByteSwap},
+  {"tableload", benchmarkTableLoad},
+};
+
+int main(int argc, char *argv[])
+{
+  unsigned numBenchmarks = sizeof(benchmarks)/sizeof(benchmarks[0]);
+  if (argc < 2)
+  {
+    printf("usage: %s all | <benchmark> ...\n\nbenchmarks:\n", argv[0]);
+    for (unsigned i = 0; i < numBenchmarks; i++)
+    {
+      printf("  %s\n", benchmarks[i].name);
+    }
+    return (1);
+  }
+  for (int arg = 1; arg < argc; arg++)
+  {
+    bool found = false;
+    for (unsigned i = 0; i < numBenchmarks; i++)
+    {
+      if ((strcmp(argv[arg], "all") == 0) || (strcmp(argv[arg], benchmarks[i].name) == 0))
+      {
+        benchmarks[i].function();
+        found = true;
+      }
+    }
+    if (!found)
+    {
+      printf("ERROR: unknown benchmark: %s\n", argv[arg]);
+    }
+  }
+  return (0);
+}